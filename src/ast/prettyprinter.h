@@ -48,6 +48,13 @@ class PrettyPrinter : public Visitor {
   }
 
   bool Constant(ConstantNode& node) override {
+    pp("Constant", node) << " ["
+      << "name='" << node.name << "'"
+      << "]" << std::endl;
+
+    depth_++;
+    node.expr->Visit(*this);
+    depth_--;
     return false;
   }
 
@@ -58,6 +65,13 @@ class PrettyPrinter : public Visitor {
     return false;
   }
 
+  bool ConstantExpression(ConstantExpressionNode& node) override {
+    pp("ConstantExpression", node) << " ["
+      << "name='" << node.name << "'"
+      << "]" << std::endl;
+    return false;
+  }
+
   bool IntegralLiteral(IntegralLiteralNode& node) override {
     pp("IntegralLiteral", node) << " ["
       << "literal='" << node.literal << "'"
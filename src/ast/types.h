@@ -2,6 +2,7 @@
 #define DARLANG_SRC_AST_TYPES_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "util/location.h"
@@ -14,6 +15,7 @@ struct ModuleNode;
 struct DeclarationNode;
 struct ConstantNode;
 struct IdExpressionNode;
+struct ConstantExpressionNode;
 struct IntegralLiteralNode;
 struct StringLiteralNode;
 struct BooleanLiteralNode;
@@ -32,6 +34,7 @@ struct Visitor {
   virtual bool Declaration(DeclarationNode& node) { return false; }
   virtual bool Constant(ConstantNode& node) { return false; }
   virtual bool IdExpression(IdExpressionNode& node) { return false; }
+  virtual bool ConstantExpression(ConstantExpressionNode& node) { return false; }
   virtual bool IntegralLiteral(IntegralLiteralNode& node) { return false; }
   virtual bool StringLiteral(StringLiteralNode& node) { return false; }
   virtual bool BooleanLiteral(BooleanLiteralNode& node) { return false; }
@@ -81,7 +84,7 @@ struct ModuleNode : public Node {
 
 struct DeclarationNode : public Node {
   DeclarationNode(std::string name, std::vector<std::string> args, std::unique_ptr<Node> expr, bool exported)
-    : name(name), args(args), expr(std::move(expr)), exported(exported) {
+    : name(name), args(args), expr(std::move(expr)), exported(exported), num_locals(0) {
     this->expr->parent = this;
   }
 
@@ -96,20 +99,26 @@ struct DeclarationNode : public Node {
   std::vector<std::string> args;
   std::unique_ptr<Node> expr;
   bool exported;
+  // The number of function-local slots (arguments followed by bindings).
+  // Populated by scoping::ScopeTransform.
+  int num_locals;
 };
 
 struct IdExpressionNode : public Node {
-  IdExpressionNode(std::string name) : name(name) {}
+  IdExpressionNode(std::string name) : name(name), local(-1) {}
 
   void Visit(Visitor& visitor) override {
     visitor.IdExpression(*this);
   }
 
   std::string name;
+  // The function-local slot of the referenced argument or binding.
+  // Populated by scoping::ScopeTransform.
+  int local;
 };
 
 struct ConstantNode : public Node {
-  ConstantNode(std::string name, std::unique_ptr<Node> expr) : name(name), expr(std::move(expr)) {
+  ConstantNode(std::string name, std::unique_ptr<Node> expr) : name(name), expr(std::move(expr)), num_locals(0) {
     this->expr->parent = this;
   }
 
@@ -119,6 +128,20 @@ struct ConstantNode : public Node {
 
   std::string name;
   std::unique_ptr<Node> expr;
+  // The number of slots for bindings within the initializer.
+  // Populated by scoping::ScopeTransform.
+  int num_locals;
+};
+
+// A reference to a module-level constant.
+struct ConstantExpressionNode : public Node {
+  ConstantExpressionNode(std::string name) : name(name) {}
+
+  void Visit(Visitor& visitor) override {
+    visitor.ConstantExpression(*this);
+  }
+
+  std::string name;
 };
 
 struct IntegralLiteralNode : public Node {
@@ -184,7 +207,7 @@ struct GuardNode : public Node {
 // A node that binds a value to an identifier and evaluates the next expression.
 struct BindNode : public Node {
   BindNode(std::string identifier, NodePtr expr, NodePtr body)
-    : identifier(identifier), expr(std::move(expr)), body(std::move(body)) {}
+    : identifier(identifier), expr(std::move(expr)), body(std::move(body)), local(-1) {}
 
   void Visit(Visitor& visitor) override {
     // TODO: respect recursive request
@@ -194,6 +217,9 @@ struct BindNode : public Node {
   std::string identifier;
   NodePtr expr;
   NodePtr body;
+  // The function-local slot assigned to the identifier.
+  // Populated by scoping::ScopeTransform.
+  int local;
 };
 
 // An ordered sequence of values.
@@ -2,6 +2,7 @@
 #define DARLANG_SRC_AST_UTIL_H_
 
 #include <cassert>
+#include <unordered_map>
 
 #include "ast/types.h"
 
@@ -51,6 +52,7 @@ class AnnotatedVisitor : public Visitor {
   virtual bool Declaration(DeclarationNode& node, T& arg) { return false; }
   virtual bool Constant(ConstantNode& node, T& arg) { return false; }
   virtual bool IdExpression(IdExpressionNode& node, T& arg) { return false; }
+  virtual bool ConstantExpression(ConstantExpressionNode& node, T& arg) { return false; }
   virtual bool IntegralLiteral(IntegralLiteralNode& node, T& arg) { return false; }
   virtual bool StringLiteral(StringLiteralNode& node, T& arg) { return false; }
   virtual bool BooleanLiteral(BooleanLiteralNode& node, T& arg) { return false; }
@@ -78,6 +80,10 @@ class AnnotatedVisitor : public Visitor {
     return IdExpression(node, annotations_[node.id]);
   }
 
+  bool ConstantExpression(ConstantExpressionNode& node) override final {
+    return ConstantExpression(node, annotations_[node.id]);
+  }
+
   bool IntegralLiteral(IntegralLiteralNode& node) override final {
     return IntegralLiteral(node, annotations_[node.id]);
   }
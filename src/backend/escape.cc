@@ -0,0 +1,184 @@
+#include "backend/escape.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "intrinsics.h"
+
+namespace darlang {
+namespace backend {
+
+// Where the value of an expression may end up, from least to most permissive.
+enum class Context {
+  // Only within the evaluating function's frame.
+  LOCAL,
+  // Beyond the evaluating function's frame, while remaining borrowed from
+  // another reference (e.g. as an argument to a tail call).
+  BORROWED,
+  ESCAPES,
+};
+
+// Propagates the context of each expression down to the locals and tuples
+// producing its value.
+class EscapeAnalysis::Visitor : public ast::Visitor {
+ public:
+  Visitor(EscapeAnalysis& result, ast::DeclarationNode& decl, bool& changed)
+    : result_(result), decl_(decl), changed_(changed)
+    , locals_(decl.num_locals, Context::LOCAL), context_(Context::ESCAPES), tail_(true) {}
+
+  void Visit(ast::Node& node, Context context, bool tail) {
+    Context outer_context = context_;
+    bool outer_tail = tail_;
+    context_ = context;
+    tail_ = tail;
+    node.Visit(*this);
+    context_ = outer_context;
+    tail_ = outer_tail;
+  }
+
+  // Returns true if a local escapes from the declaration.
+  bool Escapes(int local) const { return locals_[local] == Context::ESCAPES; }
+
+  bool IdExpression(ast::IdExpressionNode& node) override {
+    assert(node.local >= 0 && static_cast<size_t>(node.local) < locals_.size());
+    locals_[node.local] = std::max(locals_[node.local], context_);
+    return false;
+  }
+
+  bool Invocation(ast::InvocationNode& node) override {
+    // Intrinsics only inspect their arguments.
+    if (GetIntrinsic(node.callee) != Intrinsic::UNKNOWN) {
+      for (auto& arg : node.args) {
+        Visit(*arg, Context::LOCAL, false);
+      }
+      return false;
+    }
+    Arguments(node, tail_);
+    return false;
+  }
+
+  bool Guard(ast::GuardNode& node) override {
+    // The cases are owned by the cell of a recursive union wrapping them,
+    // which may live in the frame if the guard's value does.
+    if (context_ == Context::LOCAL) {
+      result_.borrowed_.insert(node.id);
+    }
+    for (auto& guard_case : node.cases) {
+      Visit(*guard_case.first, Context::LOCAL, false);
+      Visit(*guard_case.second, Context::ESCAPES, tail_);
+    }
+    Visit(*node.wildcard_case, Context::ESCAPES, tail_);
+    return false;
+  }
+
+  bool Bind(ast::BindNode& node) override {
+    // All uses of the binding are within its body.
+    Visit(*node.body, context_, tail_);
+    assert(node.local >= 0 && static_cast<size_t>(node.local) < locals_.size());
+    Visit(*node.expr, locals_[node.local], false);
+    return false;
+  }
+
+  bool Tuple(ast::TupleNode& node) override {
+    if (context_ == Context::LOCAL) {
+      result_.borrowed_.insert(node.id);
+    }
+
+    // Items are owned by the tuple, but may live no longer than it.
+    Context item_context = context_ == Context::ESCAPES ? Context::ESCAPES : Context::BORROWED;
+    for (size_t i = 0; i < node.items.size(); i++) {
+      auto& item = *std::get<ast::NodePtr>(node.items[i]);
+
+      // A trailing recursive call may be made as a tail call, filling in the
+      // tuple in place (see LLVMValueTransformer::TailRecursiveCons).
+      auto call = dynamic_cast<ast::InvocationNode*>(&item);
+      if (tail_ && call && call->callee == decl_.name && i == node.items.size() - 1) {
+        Visit(item, item_context, false);
+        Arguments(*call, true);
+        continue;
+      }
+      Visit(item, item_context, false);
+    }
+    return false;
+  }
+
+ private:
+  // Visits the arguments of a call to a declaration.
+  void Arguments(ast::InvocationNode& node, bool tail) {
+    for (size_t i = 0; i < node.args.size(); i++) {
+      Context context = Context::ESCAPES;
+      if (!result_.ParamEscapes(node.callee, i)) {
+        // Arguments to tail calls outlive the frame. Owned arguments would
+        // also need releasing after the call returns, so the parameter takes
+        // ownership of them instead.
+        context = tail ? Context::BORROWED : Context::LOCAL;
+        if (tail && !IsBorrowedParam(*node.args[i])) {
+          result_.params_[node.callee][i] = true;
+          changed_ = true;
+          context = Context::ESCAPES;
+        }
+      }
+      Visit(*node.args[i], context, false);
+    }
+  }
+
+  // Returns true if an expression reads a parameter borrowed from the caller.
+  bool IsBorrowedParam(ast::Node& node) const {
+    auto id = dynamic_cast<ast::IdExpressionNode*>(&node);
+    return id && id->local >= 0 && static_cast<size_t>(id->local) < decl_.args.size() &&
+           !result_.ParamEscapes(decl_.name, id->local);
+  }
+
+  EscapeAnalysis& result_;
+  ast::DeclarationNode& decl_;
+  bool& changed_;
+  // The most permissive context each local is used in.
+  std::vector<Context> locals_;
+  // The context of the expression being visited.
+  Context context_;
+  // True if the expression being visited is in tail position.
+  bool tail_;
+};
+
+/* static */
+EscapeAnalysis EscapeAnalysis::Analyze(ast::ModuleNode& module) {
+  std::vector<ast::DeclarationNode*> decls;
+  EscapeAnalysis result;
+  for (auto& child : module.body) {
+    if (auto decl = dynamic_cast<ast::DeclarationNode*>(child.get())) {
+      decls.push_back(decl);
+      result.params_[decl->name] = std::vector<bool>(decl->args.size(), false);
+    }
+  }
+
+  // Parameters only ever start escaping, so iterate until none change.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    result.borrowed_.clear();
+    for (auto decl : decls) {
+      Visitor visitor(result, *decl, changed);
+      visitor.Visit(*decl->expr, Context::ESCAPES, true);
+
+      auto& params = result.params_[decl->name];
+      for (size_t i = 0; i < params.size(); i++) {
+        if (visitor.Escapes(i) && !params[i]) {
+          params[i] = true;
+          changed = true;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+bool EscapeAnalysis::ParamEscapes(const std::string& decl, size_t index) const {
+  auto it = params_.find(decl);
+  if (it == params_.end() || index >= it->second.size()) {
+    return true;
+  }
+  return it->second[index];
+}
+
+}  // namespace backend
+}  // namespace darlang
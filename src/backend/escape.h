@@ -0,0 +1,53 @@
+#ifndef DARLANG_SRC_BACKEND_ESCAPE_H_
+#define DARLANG_SRC_BACKEND_ESCAPE_H_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ast/types.h"
+
+namespace darlang {
+namespace backend {
+
+// Determines which values may outlive the function evaluating them.
+//
+// A value escapes if it is returned, stored in an escaping tuple, joined with
+// other values by a guard, or passed to a function parameter that escapes.
+// Values only read by intrinsics, stored in tuples that do not escape, or
+// passed on to parameters that do not escape are merely borrowed. Tuples (and
+// the cells of recursive unions built by guards) that are never referenced
+// beyond the evaluating function's frame may live within it.
+//
+// Parameter summaries are computed over the module's call graph to a fixed
+// point, starting from the assumption that no parameter escapes. Parameters
+// receiving owned values from tail calls are treated as escaping, so that the
+// caller has nothing left to release once the call returns.
+class EscapeAnalysis {
+ public:
+  static EscapeAnalysis Analyze(ast::ModuleNode& module);
+
+  // Returns true if a function's argument may outlive the call. Callers keep
+  // ownership of arguments to parameters that do not escape.
+  bool ParamEscapes(const std::string& decl, size_t index) const;
+
+  // Returns true if the value of a tuple or guard expression may outlive the
+  // frame evaluating it.
+  bool Escapes(const ast::Node& node) const {
+    return !borrowed_.count(node.id);
+  }
+
+ private:
+  class Visitor;
+
+  // Escaping parameters, by declaration name.
+  std::unordered_map<std::string, std::vector<bool>> params_;
+  // Tuples and guards whose values do not escape.
+  std::unordered_set<ast::NodeID> borrowed_;
+};
+
+}  // namespace backend
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_BACKEND_ESCAPE_H_
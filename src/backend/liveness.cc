@@ -0,0 +1,80 @@
+#include "backend/liveness.h"
+
+namespace darlang {
+namespace backend {
+
+// Walks expressions in reverse evaluation order, tracking the set of locals
+// live after the current node.
+class Liveness::Visitor : public ast::Visitor {
+ public:
+  Visitor(Liveness& result, int num_locals) : result_(result), live_(num_locals) {}
+
+  void Visit(ast::Node& node) {
+    node.Visit(*this);
+    result_.live_in_[node.id] = live_;
+  }
+
+  bool IdExpression(ast::IdExpressionNode& node) override {
+    assert(node.local >= 0 && static_cast<size_t>(node.local) < live_.size());
+    if (!live_[node.local]) {
+      result_.last_uses_.insert(node.id);
+    }
+    live_[node.local] = true;
+    return false;
+  }
+
+  bool Invocation(ast::InvocationNode& node) override {
+    for (auto it = node.args.rbegin(); it != node.args.rend(); it++) {
+      Visit(**it);
+    }
+    return false;
+  }
+
+  bool Guard(ast::GuardNode& node) override {
+    const LocalSet live_out = live_;
+
+    // Each condition is followed by either its case, or the checks after it.
+    Visit(*node.wildcard_case);
+    LocalSet next = live_;
+    for (auto it = node.cases.rbegin(); it != node.cases.rend(); it++) {
+      live_ = live_out;
+      Visit(*it->second);
+      for (size_t i = 0; i < live_.size(); i++) {
+        live_[i] = live_[i] || next[i];
+      }
+      Visit(*it->first);
+      next = live_;
+    }
+    return false;
+  }
+
+  bool Bind(ast::BindNode& node) override {
+    Visit(*node.body);
+    assert(node.local >= 0 && static_cast<size_t>(node.local) < live_.size());
+    live_[node.local] = false;
+    Visit(*node.expr);
+    return false;
+  }
+
+  bool Tuple(ast::TupleNode& node) override {
+    for (auto it = node.items.rbegin(); it != node.items.rend(); it++) {
+      Visit(*std::get<ast::NodePtr>(*it));
+    }
+    return false;
+  }
+
+ private:
+  Liveness& result_;
+  LocalSet live_;
+};
+
+/* static */
+Liveness Liveness::Analyze(ast::DeclarationNode& node) {
+  Liveness result;
+  Visitor visitor(result, node.num_locals);
+  visitor.Visit(*node.expr);
+  return result;
+}
+
+}  // namespace backend
+}  // namespace darlang
@@ -0,0 +1,44 @@
+#ifndef DARLANG_SRC_BACKEND_LIVENESS_H_
+#define DARLANG_SRC_BACKEND_LIVENESS_H_
+
+#include <unordered_set>
+#include <vector>
+
+#include "ast/types.h"
+#include "ast/util.h"
+
+namespace darlang {
+namespace backend {
+
+// A set of function-local slots, indexed by slot.
+typedef std::vector<bool> LocalSet;
+
+// The liveness of a declaration's locals, in the evaluation order used by the
+// backend: invocation arguments and tuple items from left to right, and guard
+// conditions one at a time until a case is taken.
+class Liveness {
+ public:
+  static Liveness Analyze(ast::DeclarationNode& node);
+
+  // Returns the locals that may be read by, or after, evaluating a node.
+  const LocalSet& LiveIn(const ast::Node& node) const {
+    assert(live_in_.count(node.id));
+    return live_in_.at(node.id);
+  }
+
+  // Returns true if no later reads of the referenced local may follow.
+  bool IsLastUse(const ast::IdExpressionNode& node) const {
+    return last_uses_.count(node.id);
+  }
+
+ private:
+  class Visitor;
+
+  ast::AnnotationMap<LocalSet> live_in_;
+  std::unordered_set<ast::NodeID> last_uses_;
+};
+
+}  // namespace backend
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_BACKEND_LIVENESS_H_
@@ -0,0 +1,116 @@
+#include "backend/llvm_attributes.h"
+
+#include <unordered_set>
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+
+namespace darlang::backend {
+
+namespace {
+
+// Returns true if an instruction only touches memory within its function's
+// stack frame, or reads constant data.
+bool IsFrameLocal(llvm::Instruction& inst) {
+  llvm::Value* addr = nullptr;
+  bool read_only = false;
+  if (auto load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+    addr = load->getPointerOperand();
+    read_only = true;
+  } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(&inst)) {
+    addr = store->getPointerOperand();
+  }
+  if (!addr) {
+    return false;
+  }
+  llvm::Value* object = llvm::getUnderlyingObject(addr);
+  auto global = llvm::dyn_cast<llvm::GlobalVariable>(object);
+  return llvm::isa<llvm::AllocaInst>(object) || (read_only && global && global->isConstant());
+}
+
+// Returns true if a function has no observable memory effects, assuming that
+// calls to `candidates` do not either.
+bool IsReadNone(llvm::Function& func, const std::unordered_set<llvm::Function*>& candidates) {
+  for (auto& block : func) {
+    for (auto& inst : block) {
+      if (!inst.mayReadOrWriteMemory() || IsFrameLocal(inst)) {
+        continue;
+      }
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      auto callee = call ? call->getCalledFunction() : nullptr;
+      if (!callee || !(candidates.count(callee) || callee->doesNotAccessMemory())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns true if a function is free of loops, and only calls functions that
+// are known to return.
+bool WillReturn(llvm::Function& func) {
+  llvm::SmallVector<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>, 4> backedges;
+  llvm::FindFunctionBackedges(func, backedges);
+  if (!backedges.empty()) {
+    return false;
+  }
+  for (auto& block : func) {
+    for (auto& inst : block) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      if (!call) {
+        continue;
+      }
+      auto callee = call->getCalledFunction();
+      if (!callee || !callee->willReturn()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+/* static */
+void LLVMFunctionAttributes::Infer(llvm::Module& module) {
+  std::vector<llvm::Function*> defined;
+  for (auto& func : module) {
+    if (!func.isDeclaration()) {
+      func.addFnAttr(llvm::Attribute::NoUnwind);
+      defined.push_back(&func);
+    }
+  }
+
+  // Assume every function is free of memory effects, and discard those that
+  // are not until none change. Mutually recursive functions stay readnone
+  // only if none of them touch memory.
+  std::unordered_set<llvm::Function*> readnone(defined.begin(), defined.end());
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto func : defined) {
+      if (readnone.count(func) && !IsReadNone(*func, readnone)) {
+        readnone.erase(func);
+        changed = true;
+      }
+    }
+  }
+  for (auto func : readnone) {
+    func->setDoesNotAccessMemory();
+  }
+
+  // Conversely, only functions whose callees are already known to return may
+  // be marked, leaving any recursive functions unmarked.
+  changed = true;
+  while (changed) {
+    changed = false;
+    for (auto func : defined) {
+      if (!func->willReturn() && WillReturn(*func)) {
+        func->addFnAttr(llvm::Attribute::WillReturn);
+        changed = true;
+      }
+    }
+  }
+}
+
+}  // namespace darlang::backend
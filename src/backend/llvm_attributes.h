@@ -0,0 +1,25 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_ATTRIBUTES_H_
+#define DARLANG_SRC_BACKEND_LLVM_ATTRIBUTES_H_
+
+#include "llvm/IR/Module.h"
+
+namespace darlang::backend {
+
+// Infers function attributes for generated code, so that they are available
+// to interprocedural optimizations (and the JIT) regardless of the pipeline
+// run afterwards.
+class LLVMFunctionAttributes {
+ public:
+  // Attaches attributes to every function defined in a module:
+  //
+  // - nounwind, as darlang has no exceptions.
+  // - readnone, for functions that neither allocate nor touch the heap, and
+  //   only call other readnone functions.
+  // - willreturn, for functions free of loops and recursion that only call
+  //   other willreturn functions.
+  static void Infer(llvm::Module& module);
+};
+
+}  // namespace darlang::backend
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_ATTRIBUTES_H_
@@ -1,44 +1,68 @@
 #include "backend/llvm_backend.h"
+#include "backend/llvm_attributes.h"
+#include "backend/llvm_constants.h"
+#include "backend/llvm_disjoint.h"
+#include "backend/llvm_folder.h"
 #include "backend/llvm_intrinsics.h"
 #include "backend/llvm_symbol_namer.h"
 #include "backend/llvm_typer.h"
 #include "backend/llvm_prelude.h"
+#include "backend/llvm_refcount.h"
 #include "typing/solver.h"
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace darlang {
 namespace backend {
 
 /* static */
 std::unique_ptr<llvm::Module> LLVMModuleTransformer::Transform(
-    llvm::LLVMContext& context, typing::SpecializationMap& specs, ast::Node& node) {
-  LLVMModuleTransformer transformer(context, specs);
+    llvm::LLVMContext& context, typing::SpecializationMap& specs, ast::Node& node,
+    const llvm::DataLayout& layout, const LLVMBackendOptions& options) {
+  LLVMModuleTransformer transformer(context, specs, layout, options);
   node.Visit(transformer);
   return std::move(transformer.module_);
 }
 
 bool LLVMModuleTransformer::Module(ast::ModuleNode& node) {
-  module_ = llvm::make_unique<llvm::Module>(node.name, context_);
+  module_ = std::make_unique<llvm::Module>(node.name, context_);
   SymbolTable symbols;
-  LLVMTypeCache cache;
+  FunctionTable functions;
+
+  module_->setDataLayout(layout_);
+  LLVMTypeCache cache(module_->getDataLayout(), options_.max_direct_aggregate_size);
+  LLVMPrelude prelude(module_.get(), module_->getDataLayout());
+  LLVMRefCounter refcounter(module_.get(), prelude, cache);
 
-  llvm::DataLayout layout(module_.get());
-  LLVMPrelude prelude(module_.get(), layout);
+  // Detect specializations that generate identical code, which share a single
+  // function body.
+  FoldMap folds = LLVMSpecializationFolder::Fold(context_, specs_, cache, node);
+  EscapeAnalysis escapes = EscapeAnalysis::Analyze(node);
 
-  // Perform an initial pass to populate function declarations.
-  LLVMDeclarationTransformer decl_transform(module_.get(), specs_, symbols, cache);
+  // Perform an initial pass to populate function declarations, and evaluate
+  // constants.
+  util::DeclarationMap decls = util::DeclarationMapper::Map(node);
+  LLVMConstantPool constants(module_.get());
+  LLVMConstantEvaluator evaluator(constants, specs_, decls, cache, ErrorLog);
+  LLVMDeclarationTransformer decl_transform(module_.get(), specs_, folds, symbols, functions, evaluator, cache,
+                                            options_);
   for (auto& child : node.body) {
     child->Visit(decl_transform);
   }
 
-  LLVMFunctionTransformer func_transform(context_, specs_, symbols, cache, prelude);
+  LLVMFunctionTransformer func_transform(context_, specs_, folds, functions, constants, cache, prelude,
+                                         refcounter, escapes, options_);
   for (auto& child : node.body) {
     child->Visit(func_transform);
   }
+
+  LLVMFunctionAttributes::Infer(*module_);
   return false;
 }
 
 bool LLVMDeclarationTransformer::Declaration(ast::DeclarationNode& node) {
-  auto func_specs = specs_.Get(node.name);
+  const auto& func_specs = specs_.Get(node.name);
 
   // Only allow one specialization for monomorphic functions.
   if (!node.exported) {
@@ -46,82 +70,344 @@ bool LLVMDeclarationTransformer::Declaration(ast::DeclarationNode& node) {
   }
   // TODO(acomminos): warn about empty func_specs?
 
+  // Specializations are only called from within the module, other than entry
+  // points (which are never specialized).
+  auto linkage = node.exported && options_.internalize ? llvm::GlobalValue::InternalLinkage
+                                                       : llvm::GlobalValue::ExternalLinkage;
+
   for (auto& spec : func_specs) {
-    std::string symbol_name;
-    if (node.exported) {
-      symbol_name = LLVMSymbolNamer::Declaration(node.name, *spec.func_typeable->Solve());
-    } else {
-      symbol_name = node.name;
+    typing::Type& spec_type = specs_.registry().Get(spec.func_type);
+    std::string symbol_name = LLVMSymbolNamer::Specialization(node, spec_type);
+    auto func_type = static_cast<llvm::FunctionType*>(LLVMTypeGenerator::Generate(module_->getContext(), spec_type, cache_));
+
+    // Folded specializations alias the function implementing them.
+    auto fold = folds_.find(&spec);
+    if (fold != folds_.end()) {
+      std::string impl_name = LLVMSymbolNamer::Specialization(node, specs_.registry().Get(fold->second->func_type));
+      if (impl_name == symbol_name) {
+        // Specializations differing only in tags share a symbol.
+        functions_[&spec] = functions_.at(fold->second);
+        continue;
+      }
+      auto impl = llvm::cast<llvm::Function>(functions_.at(fold->second));
+      auto aliasee = llvm::ConstantExpr::getBitCast(impl, func_type->getPointerTo());
+      auto alias = llvm::GlobalAlias::create(func_type, 0, linkage, symbol_name, aliasee, module_);
+      symbols_.Assign(symbol_name, alias);
+      functions_[&spec] = alias;
+      continue;
     }
 
-    auto func_type = static_cast<llvm::FunctionType*>(LLVMTypeGenerator::Generate(module_->getContext(), spec.func_typeable, cache_));
-    auto func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, symbol_name, module_);
+    auto func = llvm::Function::Create(func_type, linkage, symbol_name, module_);
+    func->setCallingConv(LLVMValueTransformer::CallingConv(node));
+    if (auto abi = cache_.LookupABI(func_type)) {
+      abi->AddAttributes(func);
+    }
+    AddPointerAttributes(func, cache_);
     // TODO(acomminos): check for duplicates, assign using symbol name
     symbols_.Assign(symbol_name, func);
+    functions_[&spec] = func;
   }
   return false;
 }
 
+/* static */
+void LLVMDeclarationTransformer::AddPointerAttributes(llvm::Function* func, LLVMTypeCache& cache) {
+  auto cell_size = [&](llvm::Type* type) -> uint64_t {
+    auto cell_type = cache.HeapCell(type);
+    return cell_type && !cache.LookupTaggedRef(type) ? cache.AllocSize(cell_type) : 0;
+  };
+  // References to a union of the unit and a cell point to the cell, if any.
+  auto nullable_size = [&](llvm::Type* type) -> uint64_t {
+    auto layout = cache.LookupTaggedRef(type);
+    if (!layout || layout->kind != LLVMDisjointLayout::NULLABLE) {
+      return 0;
+    }
+    for (auto member : layout->members) {
+      if (auto cell_type = cache.HeapCell(member)) {
+        return cache.AllocSize(cell_type);
+      }
+    }
+    return 0;
+  };
+
+  // Slots for aggregates passed through memory, and destinations of
+  // destination-passing calls, may point anywhere the caller chooses.
+  for (unsigned int i = 0; i < func->arg_size(); i++) {
+    if (func->hasParamAttribute(i, llvm::Attribute::StructRet) ||
+        func->hasParamAttribute(i, llvm::Attribute::ByVal)) {
+      continue;
+    }
+    if (uint64_t size = cell_size(func->getArg(i)->getType())) {
+      func->addParamAttr(i, llvm::Attribute::NonNull);
+      func->addDereferenceableParamAttr(i, size);
+    } else if (uint64_t size = nullable_size(func->getArg(i)->getType())) {
+      func->addDereferenceableOrNullParamAttr(i, size);
+    }
+  }
+  if (uint64_t size = cell_size(func->getReturnType())) {
+    func->addRetAttr(llvm::Attribute::NonNull);
+    func->addRetAttr(llvm::Attribute::getWithDereferenceableBytes(func->getContext(), size));
+  } else if (uint64_t size = nullable_size(func->getReturnType())) {
+    func->addRetAttr(llvm::Attribute::getWithDereferenceableOrNullBytes(func->getContext(), size));
+  }
+}
+
 bool LLVMDeclarationTransformer::Constant(ast::ConstantNode& node) {
-  // TODO(acomminos)
-  assert(false);
+  evaluator_.Global(node.name);
   return false;
 }
 
 bool LLVMFunctionTransformer::Declaration(ast::DeclarationNode& node) {
-  auto func_specs = specs_.Get(node.name);
+  const auto& func_specs = specs_.Get(node.name);
 
   // Only allow one specialization for monomorphic functions.
   if (!node.exported) {
     assert(func_specs.size() == 1);
   }
 
+  Liveness liveness = Liveness::Analyze(node);
+
   // TODO(acomminos): warn about empty func_specs?
   for (auto& spec : func_specs) {
-    std::string symbol_name;
-    if (node.exported) {
-      symbol_name = LLVMSymbolNamer::Declaration(node.name, *spec.func_typeable->Solve());
-    } else {
-      symbol_name = node.name;
+    // Folded specializations have no body of their own.
+    if (folds_.count(&spec)) {
+      continue;
     }
 
-    // FIXME(acomminos): casts make me sad.
-    auto func = static_cast<llvm::Function*>(symbols_.Lookup(symbol_name));
-    assert(func);
+    auto func = llvm::cast<llvm::Function>(functions_.at(&spec));
 
-    auto entry_block = llvm::BasicBlock::Create(context_, "entry", func);
+    FunctionState function(func, node.num_locals);
+    function.callees = &spec.callees;
+    function.escapes = &escapes_;
+    function.constants = &constants_;
+    if (options_.reference_counting) {
+      function.liveness = &liveness;
+    }
+    Body(node, spec, function, func);
 
-    int arg_idx = 0;
-    SymbolTable arg_symbols(symbols_);
-    for (auto it = func->arg_begin(); it != func->arg_end(); it++) {
-      arg_symbols.Assign(node.args[arg_idx++], it);
+    // Generate the destination-passing variant if tail recursion modulo cons
+    // was used. It shares the function's arguments, followed by the slot to
+    // store its result in.
+    if (function.dps_func) {
+      FunctionState dps_function(func, node.num_locals);
+      dps_function.callees = function.callees;
+      dps_function.liveness = function.liveness;
+      dps_function.escapes = function.escapes;
+      dps_function.constants = function.constants;
+      dps_function.dps_func = function.dps_func;
+      dps_function.dest = &*(function.dps_func->arg_end() - 1);
+      Body(node, spec, dps_function, function.dps_func);
     }
+  }
+  return false;
+}
 
-    llvm::IRBuilder<> builder(context_);
-    builder.SetInsertPoint(entry_block);
+void LLVMFunctionTransformer::Body(ast::DeclarationNode& node,
+                                   const typing::Specialization& spec,
+                                   FunctionState& function,
+                                   llvm::Function* func) {
+  auto entry_block = llvm::BasicBlock::Create(context_, "entry", func);
+  llvm::IRBuilder<> builder(context_);
+  builder.SetInsertPoint(entry_block);
 
-    auto expr = LLVMValueTransformer::Transform(context_, builder, spec.typeables, arg_symbols, cache_, prelude_, *node.expr);
-    builder.CreateRet(expr);
+  // Wide arguments are passed as a pointer to the caller's copy, and wide
+  // results stored to the caller's slot.
+  const LLVMFunctionABI* abi = cache_.LookupABI(func->getFunctionType());
+  if (abi && abi->sret) {
+    function.sret = func->getArg(0);
+  }
+
+  // Arguments occupy the first local slots, followed by bindings. Callers
+  // pass ownership of a reference along with each argument, unless it does
+  // not escape.
+  for (unsigned int i = 0; i < node.args.size(); i++) {
+    llvm::Value* arg = func->getArg(abi ? abi->ParamIndex(i) : i);
+    if (abi && abi->byval[i]) {
+      arg = builder.CreateLoad(abi->byval[i], arg);
+    }
+    function.locals[i] = arg;
+    if (function.liveness && refcounter_.IsCounted(arg->getType())) {
+      if (function.escapes->ParamEscapes(node.name, i)) {
+        function.owned[i] = true;
+      } else {
+        function.borrowed.insert(arg);
+      }
+    }
+  }
+
+  if (function.liveness) {
+    LLVMValueTransformer::DropDead(builder, function, prelude_, refcounter_,
+                                   function.liveness->LiveIn(*node.expr), true);
+  }
+
+  // The declaration's expression is in tail position, and returns its value.
+  LLVMValueTransformer::Transform(context_, builder, spec.types, specs_.registry(), functions_, function, cache_, prelude_, refcounter_, options_, *node.expr, true);
+
+  // Nothing allocated by the program outlives `main`, unless its result
+  // references a heap value (directly, or through a field of a tuple passed
+  // by value). Release the heap on each of its returns.
+  if (!node.exported && !refcounter_.IsCounted(func->getReturnType())) {
+    for (auto& block : *func) {
+      auto ret = llvm::dyn_cast<llvm::ReturnInst>(block.getTerminator());
+      if (!ret) {
+        continue;
+      }
+      auto prev = llvm::dyn_cast_or_null<llvm::CallInst>(ret->getPrevNode());
+      if (prev && prev->isMustTailCall()) {
+        continue;
+      }
+      builder.SetInsertPoint(ret);
+      prelude_.CreateHeapReset(builder);
+    }
   }
-  return false;
 }
 
 /* static */
 llvm::Value* LLVMValueTransformer::Transform(llvm::LLVMContext& context,
                                              llvm::IRBuilder<>& builder,
-                                             typing::TypeableMap& types,
-                                             const SymbolTable& symbols,
+                                             const typing::TypeTable& types,
+                                             const typing::TypeRegistry& registry,
+                                             const FunctionTable& functions,
+                                             FunctionState& function,
                                              LLVMTypeCache& cache,
                                              LLVMPrelude& prelude,
-                                             ast::Node& node) {
-  LLVMValueTransformer transformer(context, builder, types, symbols, cache, prelude);
+                                             LLVMRefCounter& refcounter,
+                                             const LLVMBackendOptions& options,
+                                             ast::Node& node,
+                                             bool tail,
+                                             typing::Type* tail_union) {
+  LLVMValueTransformer transformer(context, builder, types, registry, functions, function, cache, prelude, refcounter, options, tail, tail_union);
   node.Visit(transformer);
+
+  // Return values of expressions in tail position that did not return on
+  // their own (i.e. leaves, such as literals and calls).
+  if (tail && !builder.GetInsertBlock()->getTerminator()) {
+    llvm::Value* value = transformer.value();
+    if (tail_union) {
+      value = transformer.Inject(value, transformer.TypeOf(node), *tail_union);
+    }
+    transformer.ReleaseReuse();
+    if (!function.sret) {
+      value = transformer.Coerce(value, function.func->getReturnType());
+    }
+    if (function.dest || function.sret) {
+      builder.CreateStore(value, function.dest ? function.dest : function.sret);
+      builder.CreateRetVoid();
+    } else {
+      builder.CreateRet(value);
+    }
+  }
   return transformer.value();
 }
 
+/* static */
+llvm::CallingConv::ID LLVMValueTransformer::CallingConv(const ast::DeclarationNode& decl) {
+  return decl.exported ? llvm::CallingConv::Tail : llvm::CallingConv::C;
+}
+
+llvm::Value* LLVMValueTransformer::TransformChild(ast::Node& node) {
+  return Transform(context_, builder_, types_, registry_, functions_, function_, cache_, prelude_, refcounter_, options_, node);
+}
+
+llvm::Value* LLVMValueTransformer::TransformTailChild(ast::Node& node, typing::Type* tail_union) {
+  return Transform(context_, builder_, types_, registry_, functions_, function_, cache_, prelude_, refcounter_, options_,
+                   node, tail_, tail_union ? tail_union : tail_union_);
+}
+
+llvm::Value* LLVMValueTransformer::TransformItem(ast::Node& node) {
+  auto value = TransformChild(node);
+  // Values borrowed from the caller may be stored in tuples that do not
+  // escape, which release their items like any other.
+  if (function_.borrowed.count(value)) {
+    refcounter_.CreateDup(builder_, value);
+  }
+  return value;
+}
+
+/* static */
+void LLVMValueTransformer::DropDead(llvm::IRBuilder<>& builder, FunctionState& function,
+                                    LLVMPrelude& prelude, LLVMRefCounter& refcounter,
+                                    const LocalSet& live, bool reuse) {
+  for (size_t i = 0; i < function.owned.size(); i++) {
+    if (!function.owned[i] || live[i]) {
+      continue;
+    }
+    function.owned[i] = false;
+
+    llvm::Value* value = function.locals[i];
+    llvm::StructType* reuse_type = nullptr;
+    if (reuse && value->getType()->isPointerTy() && !function.stack.count(value)) {
+      reuse_type = refcounter.ReuseType(value);
+    }
+    if (reuse_type) {
+      uint64_t size = prelude.HeapBlockSize(reuse_type);
+      function.reuse.push_back({size, refcounter.CreateDropReuse(builder, value)});
+    } else {
+      Drop(builder, function, refcounter, value);
+    }
+  }
+}
+
+/* static */
+void LLVMValueTransformer::Drop(llvm::IRBuilder<>& builder, FunctionState& function,
+                                LLVMRefCounter& refcounter, llvm::Value* value) {
+  if (function.borrowed.count(value)) {
+    return;
+  }
+  if (function.stack.count(value)) {
+    refcounter.CreateDropFields(builder, value);
+  } else {
+    refcounter.CreateDrop(builder, value);
+  }
+}
+
+llvm::Value* LLVMValueTransformer::TakeReuse(llvm::Type* type) {
+  uint64_t size = prelude_.HeapBlockSize(type);
+  for (auto it = function_.reuse.begin(); it != function_.reuse.end(); it++) {
+    if (it->size == size) {
+      llvm::Value* block = it->block;
+      function_.reuse.erase(it);
+      return block;
+    }
+  }
+  return nullptr;
+}
+
+void LLVMValueTransformer::ReleaseReuse() {
+  for (auto& token : function_.reuse) {
+    prelude_.CreateHeapFree(builder_, token.block, token.size);
+  }
+  function_.reuse.clear();
+}
+
 bool LLVMValueTransformer::IdExpression(ast::IdExpressionNode& node) {
-  value_ = symbols_.Lookup(node.name);
+  assert(node.local >= 0 && static_cast<size_t>(node.local) < function_.locals.size());
+  value_ = function_.locals[node.local];
   assert(value_ != nullptr);
+
+  // Each use of a local produces a new reference, moved out of the local on
+  // its last use.
+  if (function_.owned[node.local]) {
+    if (function_.liveness->IsLastUse(node)) {
+      function_.owned[node.local] = false;
+    } else if (function_.stack.count(value_)) {
+      refcounter_.CreateDupFields(builder_, value_);
+    } else {
+      refcounter_.CreateDup(builder_, value_);
+    }
+  }
+  return false;
+}
+
+bool LLVMValueTransformer::ConstantExpression(ast::ConstantExpressionNode& node) {
+  // Constants were evaluated at compile time. Scalars are used inline, while
+  // aggregates are loaded from their global as needed.
+  llvm::GlobalVariable* global = function_.constants->Lookup(node.name);
+  if (global->getValueType()->isAggregateType()) {
+    value_ = builder_.CreateLoad(global->getValueType(), global);
+  } else {
+    value_ = global->getInitializer();
+  }
   return false;
 }
 
@@ -133,9 +419,8 @@ bool LLVMValueTransformer::IntegralLiteral(ast::IntegralLiteralNode& node) {
 
 bool LLVMValueTransformer::StringLiteral(ast::StringLiteralNode& node) {
   // Represent strings as a pointer to null-terminated characters in static
-  // data. LLVM will automatically null-terminate this, which we may want to
-  // reconsider later.
-  value_ = builder_.CreateGlobalStringPtr(node.literal);
+  // data, shared by every occurrence of the literal in the module.
+  value_ = function_.constants->String(node.literal);
   return false;
 }
 
@@ -144,41 +429,433 @@ bool LLVMValueTransformer::BooleanLiteral(ast::BooleanLiteralNode& node) {
   return false;
 }
 
+llvm::Value* LLVMValueTransformer::CreateCall(llvm::Value* callee, const std::vector<llvm::Value*>& args,
+                                              bool allow_tail) {
+  auto callee_value = llvm::cast<llvm::GlobalValue>(callee);
+  auto callee_func = llvm::cast<llvm::Function>(callee_value->getAliaseeObject());
+  auto func_type = llvm::cast<llvm::FunctionType>(callee_value->getValueType());
+  const LLVMFunctionABI* abi = cache_.LookupABI(func_type);
+
+  std::vector<llvm::Value*> call_args(args);
+  LowerArguments(func_type, call_args);
+
+  // A wide result in tail position is stored straight to this function's own
+  // result slot. Otherwise, it is loaded from a temporary slot once the call
+  // returns, which the callee may not outlive.
+  llvm::Value* result_slot = nullptr;
+  if (abi && abi->sret) {
+    if (tail_ && allow_tail && function_.sret && function_.sret->getType() == func_type->getParamType(0)) {
+      result_slot = function_.sret;
+    } else {
+      result_slot = CreateSlot(abi->sret);
+      allow_tail = false;
+    }
+    call_args.insert(call_args.begin(), result_slot);
+  }
+
+  auto call = builder_.CreateCall(func_type, callee, call_args);
+  call->setCallingConv(callee_func->getCallingConv());
+  if (abi) {
+    abi->AddAttributes(call);
+  }
+
+  // Results are stored after calls return in destination-passing functions,
+  // so calls are never in tail position.
+  if (tail_ && allow_tail && !function_.dest) {
+    auto caller_func = builder_.GetInsertBlock()->getParent();
+    if (caller_func->getCallingConv() == llvm::CallingConv::Tail &&
+        callee_func->getCallingConv() == llvm::CallingConv::Tail) {
+      // Tail calls between tailcc functions are guaranteed to be eliminated,
+      // regardless of their prototypes.
+      call->setTailCallKind(llvm::CallInst::TCK_Tail);
+    } else if (caller_func->getCallingConv() == callee_func->getCallingConv() &&
+               caller_func->getFunctionType() == func_type) {
+      call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+    }
+  }
+
+  if (!result_slot) {
+    return call;
+  }
+  if (result_slot == function_.sret) {
+    builder_.CreateRetVoid();
+    return llvm::UndefValue::get(abi->sret);
+  }
+  return builder_.CreateLoad(abi->sret, result_slot);
+}
+
+void LLVMValueTransformer::LowerArguments(llvm::FunctionType* func_type, std::vector<llvm::Value*>& args) {
+  const LLVMFunctionABI* abi = cache_.LookupABI(func_type);
+  if (!abi) {
+    for (unsigned int i = 0; i < args.size(); i++) {
+      args[i] = Coerce(args[i], func_type->getParamType(i));
+    }
+    return;
+  }
+  // The callee receives its own copy of each, so a single slot per call site
+  // suffices even when passed to a tail call. Constant aggregates are copied
+  // straight from their global.
+  for (unsigned int i = 0; i < abi->byval.size(); i++) {
+    if (!abi->byval[i]) {
+      args[i] = Coerce(args[i], func_type->getParamType(abi->ParamIndex(i)));
+      continue;
+    }
+    if (auto constant = llvm::dyn_cast<llvm::Constant>(args[i])) {
+      args[i] = function_.constants->Global(constant);
+      continue;
+    }
+    // Named constants are loaded from their global, which can be passed as is.
+    auto load = llvm::dyn_cast<llvm::LoadInst>(args[i]);
+    auto global = load ? llvm::dyn_cast<llvm::GlobalVariable>(load->getPointerOperand()) : nullptr;
+    if (global && global->isConstant() && global->getValueType() == abi->byval[i]) {
+      args[i] = global;
+    } else {
+      llvm::Value* slot = CreateSlot(abi->byval[i]);
+      builder_.CreateStore(args[i], slot);
+      args[i] = slot;
+    }
+  }
+}
+
+llvm::Value* LLVMValueTransformer::CreateSlot(llvm::Type* type) {
+  auto& entry_block = builder_.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> entry_builder(&entry_block, entry_block.begin());
+  return entry_builder.CreateAlloca(type);
+}
+
+llvm::Value* LLVMValueTransformer::LookupCallee(ast::InvocationNode& node) const {
+  if (GetIntrinsic(node.callee) != Intrinsic::UNKNOWN) {
+    return nullptr;
+  }
+
+  // Calls were resolved to a specialization during type inference.
+  auto callee = functions_.at(function_.callees->at(node.id));
+  assert(callee != nullptr);
+  return callee;
+}
+
+bool LLVMValueTransformer::IsSelf(llvm::Value* callee) const {
+  return llvm::cast<llvm::GlobalValue>(callee)->getAliaseeObject() == function_.func;
+}
+
 bool LLVMValueTransformer::Invocation(ast::InvocationNode& node) {
   std::vector<llvm::Value*> arg_values;
   for (auto& expr : node.args) {
-    auto value = LLVMValueTransformer::Transform(context_, builder_, types_, symbols_, cache_, prelude_, *expr);
+    auto value = TransformChild(*expr);
     arg_values.push_back(value);
   }
 
-  Intrinsic intr;
-  llvm::Value* callee;
-  if ((intr = GetIntrinsic(node.callee)) != Intrinsic::UNKNOWN) {
-    value_ = GenerateIntrinsic(intr, arg_values, builder_);
-  } else if ((callee = symbols_.Lookup(node.callee))) {
-    // Use the unobfuscated symbol name, in case this is a monomorphic export or
-    // the main function.
-    value_ = builder_.CreateCall(callee, arg_values);
+  llvm::Value* callee = LookupCallee(node);
+  if (!callee) {
+    value_ = GenerateIntrinsic(GetIntrinsic(node.callee), arg_values, builder_);
+    // Intrinsics only inspect their arguments.
+    if (function_.liveness) {
+      for (auto arg_value : arg_values) {
+        Drop(builder_, function_, refcounter_, arg_value);
+      }
+    }
+    return false;
+  }
+
+  // Storage left unused by this function must be freed before a tail call.
+  if (tail_) {
+    ReleaseReuse();
+  }
+
+  bool allow_tail = true;
+  auto borrowed_args = BorrowedArgs(node.callee, arg_values, allow_tail);
+  if (tail_ && function_.dest && IsSelf(callee)) {
+    // Recursing from the destination-passing variant of a function continues
+    // its loop, storing to the same destination.
+    auto dps_func = GetDestinationPassingFunction();
+    LowerArguments(dps_func->getFunctionType(), arg_values);
+    arg_values.push_back(function_.dest);
+    auto call = builder_.CreateCall(dps_func, arg_values);
+    call->setCallingConv(llvm::CallingConv::Tail);
+    if (auto abi = cache_.LookupABI(dps_func->getFunctionType())) {
+      abi->AddAttributes(call);
+    }
+    if (allow_tail) {
+      call->setTailCallKind(llvm::CallInst::TCK_Tail);
+    }
+    for (auto arg_value : borrowed_args) {
+      Drop(builder_, function_, refcounter_, arg_value);
+    }
+    builder_.CreateRetVoid();
   } else {
-    // Otherwise, try to generate a call to the appropriate specialization by
-    // deriving it from argument types and the callee name.
-    //
-    // TODO(acomminos): make simpler, perhaps by leveraging typeable linkage?
-    std::vector<std::unique_ptr<typing::Type>> arg_types;
-    for (auto& arg_node : node.args) {
-      auto arg_typeable = types_[arg_node->id];
-      arg_types.push_back(arg_typeable->Solve());
+    value_ = CreateCall(callee, arg_values, allow_tail);
+    for (auto arg_value : borrowed_args) {
+      Drop(builder_, function_, refcounter_, arg_value);
     }
-    auto symbol_name = LLVMSymbolNamer::Call(node.callee, arg_types);
-    auto callee = symbols_.Lookup(symbol_name);
-    assert(callee != nullptr);
+  }
+  return false;
+}
 
-    value_ = builder_.CreateCall(callee, arg_values);
+std::vector<llvm::Value*> LLVMValueTransformer::BorrowedArgs(const std::string& callee,
+                                                             const std::vector<llvm::Value*>& args,
+                                                             bool& allow_tail) const {
+  std::vector<llvm::Value*> borrowed;
+  for (size_t i = 0; i < args.size(); i++) {
+    // The callee's frame replaces ours in a tail call.
+    if (function_.stack.count(args[i])) {
+      allow_tail = false;
+    }
+    if (!function_.liveness || !refcounter_.IsCounted(args[i]->getType()) ||
+        function_.escapes->ParamEscapes(callee, i)) {
+      continue;
+    }
+    if (!function_.borrowed.count(args[i])) {
+      borrowed.push_back(args[i]);
+      allow_tail = false;
+    }
+  }
+  return borrowed;
+}
+
+// Matches a guard condition comparing a local to an integer literal, i.e.
+// `is(x, 1)` or `is(1, x)`, returning the local's slot (or -1 if unmatched).
+static int MatchLiteralComparison(ast::Node& cond, int64_t& literal) {
+  auto invocation = dynamic_cast<ast::InvocationNode*>(&cond);
+  if (!invocation || GetIntrinsic(invocation->callee) != Intrinsic::IS || invocation->args.size() != 2) {
+    return -1;
+  }
+  for (int i = 0; i < 2; i++) {
+    auto id = dynamic_cast<ast::IdExpressionNode*>(invocation->args[i].get());
+    auto int_literal = dynamic_cast<ast::IntegralLiteralNode*>(invocation->args[1 - i].get());
+    if (id && int_literal) {
+      literal = int_literal->literal;
+      return id->local;
+    }
+  }
+  return -1;
+}
+
+// Returns the number of leading cases of a guard that compare the same local
+// against distinct integer literals, which may be dispatched with a switch.
+static size_t CountSwitchCases(ast::GuardNode& node) {
+  int scrutinee = -1;
+  std::unordered_set<int64_t> literals;
+  for (size_t i = 0; i < node.cases.size(); i++) {
+    int64_t literal;
+    int local = MatchLiteralComparison(*node.cases[i].first, literal);
+    if (local < 0 || (scrutinee >= 0 && local != scrutinee) || literals.count(literal)) {
+      return i;
+    }
+    scrutinee = local;
+    literals.insert(literal);
+  }
+  return node.cases.size();
+}
+
+// Returns the cost of evaluating an expression eagerly, in instructions, or -1
+// if it is not safe to evaluate unconditionally (e.g. calls, which may not
+// terminate, or a remainder that may divide by zero).
+static int SpeculationCost(ast::Node& node) {
+  if (dynamic_cast<ast::IdExpressionNode*>(&node) ||
+      dynamic_cast<ast::ConstantExpressionNode*>(&node) ||
+      dynamic_cast<ast::IntegralLiteralNode*>(&node) ||
+      dynamic_cast<ast::BooleanLiteralNode*>(&node) ||
+      dynamic_cast<ast::StringLiteralNode*>(&node)) {
+    return 0;
+  }
+
+  auto invocation = dynamic_cast<ast::InvocationNode*>(&node);
+  if (!invocation) {
+    return -1;
+  }
+  switch (GetIntrinsic(invocation->callee)) {
+    case Intrinsic::IS:
+    case Intrinsic::ADD:
+      break;
+    case Intrinsic::MOD: {
+      // Only a literal divisor other than 0 or -1 is guaranteed not to trap.
+      auto divisor = dynamic_cast<ast::IntegralLiteralNode*>(invocation->args[1].get());
+      if (!divisor || divisor->literal == 0 || divisor->literal == -1) {
+        return -1;
+      }
+      break;
+    }
+    default:
+      return -1;
+  }
+
+  int cost = 1;
+  for (auto& arg : invocation->args) {
+    int arg_cost = SpeculationCost(*arg);
+    if (arg_cost < 0) {
+      return -1;
+    }
+    cost += arg_cost;
+  }
+  return cost;
+}
+
+// The maximum number of instructions evaluated eagerly by a select-lowered
+// guard, including the selects themselves. Kept small, as every case is
+// evaluated regardless of which is taken.
+static const int kMaxGuardSelectCost = 6;
+
+bool LLVMValueTransformer::ReadsCounted(ast::Node& node) {
+  if (auto invocation = dynamic_cast<ast::InvocationNode*>(&node)) {
+    for (auto& arg : invocation->args) {
+      if (ReadsCounted(*arg)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (auto id = dynamic_cast<ast::IdExpressionNode*>(&node)) {
+    return refcounter_.IsCounted(function_.locals[id->local]->getType());
+  }
+  return false;
+}
+
+bool LLVMValueTransformer::ShouldSelect(ast::GuardNode& node) {
+  if (options_.guard_select == GuardSelect::NEVER) {
+    return false;
+  }
+
+  // All cases must produce the same type, with no need for a disjoint union.
+  if (dynamic_cast<typing::DisjointUnion*>(&TypeOf(node))) {
+    return false;
+  }
+  llvm::Type* guard_type = LLVMTypeGenerator::Generate(context_, TypeOf(node), cache_);
+  auto same_type = [&](ast::Node& expr) {
+    return LLVMTypeGenerator::Generate(context_, TypeOf(expr), cache_) == guard_type;
+  };
+  if (!same_type(*node.wildcard_case) || refcounter_.IsCounted(guard_type)) {
+    return false;
+  }
+
+  int cost = SpeculationCost(*node.wildcard_case);
+  if (cost < 0) {
+    return false;
+  }
+  for (auto& guard_case : node.cases) {
+    int cond_cost = SpeculationCost(*guard_case.first);
+    int value_cost = SpeculationCost(*guard_case.second);
+    if (cond_cost < 0 || value_cost < 0 || !same_type(*guard_case.second) ||
+        ReadsCounted(*guard_case.first)) {
+      return false;
+    }
+    cost += cond_cost + value_cost + 1;
+  }
+  return options_.guard_select == GuardSelect::ALWAYS || cost <= kMaxGuardSelectCost;
+}
+
+bool LLVMValueTransformer::GuardSelect(ast::GuardNode& node) {
+  std::vector<llvm::Value*> conds;
+  std::vector<llvm::Value*> values;
+  for (auto& guard_case : node.cases) {
+    conds.push_back(TransformChild(*guard_case.first));
+    values.push_back(TransformChild(*guard_case.second));
+  }
+
+  // Select from the last case backwards, so that the first matching case
+  // takes precedence.
+  llvm::Value* result = TransformChild(*node.wildcard_case);
+  for (int i = node.cases.size() - 1; i >= 0; i--) {
+    result = builder_.CreateSelect(conds[i], values[i], result);
+  }
+  value_ = result;
+  return false;
+}
+
+// Returns true if two types describe the same values. A recursive type may be
+// rooted at any of its components (e.g. a list, or its cons cells), so each
+// recurrence is unfolded into its parent, assuming pairs of types already
+// being compared to be equivalent.
+static bool Equivalent(const typing::Type& a, const typing::Type& b,
+                       std::vector<std::pair<const typing::Type*, const typing::Type*>>& assumed) {
+  if (auto recurrence = dynamic_cast<const typing::Recurrence*>(&a)) {
+    return Equivalent(*recurrence->parent_type(), b, assumed);
+  }
+  if (auto recurrence = dynamic_cast<const typing::Recurrence*>(&b)) {
+    return Equivalent(a, *recurrence->parent_type(), assumed);
+  }
+  if (std::find(assumed.begin(), assumed.end(), std::make_pair(&a, &b)) != assumed.end()) {
+    return true;
+  }
+  assumed.emplace_back(&a, &b);
+
+  auto all_equivalent = [&](const std::vector<const typing::Type*>& as,
+                            const std::vector<const typing::Type*>& bs) {
+    if (as.size() != bs.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < as.size(); i++) {
+      if (!Equivalent(*as[i], *bs[i], assumed)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  auto tuple_items = [](const typing::Tuple& tuple) {
+    std::vector<const typing::Type*> items;
+    for (auto& item : tuple.types()) {
+      items.push_back(std::get<std::unique_ptr<typing::Type>>(item).get());
+    }
+    return items;
+  };
+  auto members = [](const typing::DisjointUnion& disjoint) {
+    std::vector<const typing::Type*> types;
+    for (auto& type : disjoint.types()) {
+      types.push_back(type.get());
+    }
+    return types;
+  };
+
+  auto tuple_a = dynamic_cast<const typing::Tuple*>(&a);
+  auto tuple_b = dynamic_cast<const typing::Tuple*>(&b);
+  if (tuple_a || tuple_b) {
+    return tuple_a && tuple_b && all_equivalent(tuple_items(*tuple_a), tuple_items(*tuple_b));
+  }
+  auto disjoint_a = dynamic_cast<const typing::DisjointUnion*>(&a);
+  auto disjoint_b = dynamic_cast<const typing::DisjointUnion*>(&b);
+  if (disjoint_a || disjoint_b) {
+    return disjoint_a && disjoint_b && all_equivalent(members(*disjoint_a), members(*disjoint_b));
+  }
+  return a.Hash() == b.Hash();
+}
+
+// Returns true if a value of the given type can be wrapped into a union, i.e.
+// it is (equivalent to) the union itself or one of its members.
+static bool Injectable(const typing::Type& type, const typing::DisjointUnion& union_type) {
+  if (type.Hash() == union_type.Hash()) {
+    return true;
+  }
+  for (auto& member : union_type.types()) {
+    std::vector<std::pair<const typing::Type*, const typing::Type*>> assumed;
+    if (Equivalent(*member, type, assumed)) {
+      return true;
+    }
   }
   return false;
 }
 
 bool LLVMValueTransformer::Guard(ast::GuardNode& node) {
+  if (ShouldSelect(node)) {
+    return GuardSelect(node);
+  }
+
+  // Cases producing different members of a disjoint union are wrapped into it
+  // before joining, rather than returning from each case. Recursive unions are
+  // instead wrapped on each case's own path before returning, so that a
+  // recursive call building a member (e.g. a list's cons cell) remains in
+  // tail position.
+  bool tail = tail_;
+  typing::Type* tail_union = tail_union_;
+  if (tail_ && dynamic_cast<typing::DisjointUnion*>(&TypeOf(node))) {
+    if (!tail_union && LLVMTypeGenerator::Generate(context_, TypeOf(node), cache_)->isPointerTy()) {
+      tail_union = &TypeOf(node);
+    }
+    auto disjoint = static_cast<typing::DisjointUnion*>(tail_union);
+    tail = disjoint && Injectable(TypeOf(*node.wildcard_case), *disjoint);
+    for (auto& guard_case : node.cases) {
+      tail = tail && Injectable(TypeOf(*guard_case.second), *disjoint);
+    }
+  }
+
   // Get the current function we're within.
   auto parent_func = builder_.GetInsertBlock()->getParent();
 
@@ -186,103 +863,395 @@ bool LLVMValueTransformer::Guard(ast::GuardNode& node) {
   auto prelude_block = builder_.GetInsertBlock();
   // Wildcard case for when no pattern matches.
   auto wildcard_block = llvm::BasicBlock::Create(context_, "wildcard");
-  // Combinator block joining cases.
-  auto terminal_block = llvm::BasicBlock::Create(context_, "terminal");
 
-  // Insert a phi node as the first instruction in the terminal block.
-  builder_.SetInsertPoint(terminal_block);
+  // The cell of a recursive union that does not escape (if it has one) lives
+  // in the frame, shared by every case, of which only one is taken.
+  llvm::Value* stack_cell = nullptr;
+  if (!tail && options_.stack_allocation && !function_.escapes->Escapes(node) &&
+      dynamic_cast<typing::DisjointUnion*>(&TypeOf(node))) {
+    llvm::Type* union_type = LLVMTypeGenerator::Generate(context_, TypeOf(node), cache_);
+    if (union_type->isPointerTy() && !cache_.LookupTaggedRef(union_type)) {
+      stack_cell = CreateSlot(cache_.Lookup(TypeOf(node)));
+      function_.stack.insert(stack_cell);
+    }
+  }
 
-  llvm::Type* guard_type = LLVMTypeGenerator::Generate(context_, types_[node.id], cache_);
-  assert(guard_type);
+  // Combinator block joining cases, with a phi node as its first instruction.
+  // Guards in tail position return from each case instead.
+  llvm::BasicBlock* terminal_block = nullptr;
+  llvm::PHINode* phi_node = nullptr;
+  if (!tail) {
+    terminal_block = llvm::BasicBlock::Create(context_, "terminal");
+    builder_.SetInsertPoint(terminal_block);
 
-  auto phi_node = builder_.CreatePHI(guard_type, 1 + node.cases.size());
+    llvm::Type* guard_type = LLVMTypeGenerator::Generate(context_, TypeOf(node), cache_);
+    assert(guard_type);
+
+    phi_node = builder_.CreatePHI(guard_type, 1 + node.cases.size());
+  }
 
   // Must have at least one case in order to terminate the prelude block.
   assert(node.cases.size() > 0);
 
-  for (int i = 0; i < node.cases.size(); i++) {
-    auto& guard_case = node.cases[i];
-    auto case_block = llvm::BasicBlock::Create(context_, "case");
+  // Leading cases comparing a local against integer literals are dispatched
+  // with a switch, allowing jump tables or binary search. Any remaining cases
+  // are checked in order from the switch's default block.
+  size_t switch_cases = CountSwitchCases(node);
+  if (switch_cases < 2) {
+    switch_cases = 0;
+  }
+  llvm::SwitchInst* switch_inst = nullptr;
+  if (switch_cases > 0) {
+    int64_t literal;
+    int scrutinee = MatchLiteralComparison(*node.cases[0].first, literal);
+    assert(scrutinee >= 0 && static_cast<size_t>(scrutinee) < function_.locals.size());
 
-    // Compute the expression value in the case block and branch to the terminator.
-    builder_.SetInsertPoint(case_block);
-    auto expr_value = LLVMValueTransformer::Transform(context_, builder_, types_, symbols_, cache_, prelude_, *guard_case.second);
-    phi_node->addIncoming(expr_value, case_block);
-    builder_.CreateBr(terminal_block);
+    llvm::BasicBlock* default_block = wildcard_block;
+    if (switch_cases < node.cases.size()) {
+      default_block = llvm::BasicBlock::Create(context_, "check");
+    }
+    builder_.SetInsertPoint(prelude_block);
+    switch_inst = builder_.CreateSwitch(function_.locals[scrutinee], default_block, switch_cases);
+  }
 
-    parent_func->getBasicBlockList().push_back(case_block);
+  // Storage released before the guard may be reused by any one case, but not
+  // by conditions, which are evaluated before it is known which case is taken.
+  std::vector<ReuseToken> reuse = std::move(function_.reuse);
+  function_.reuse.clear();
 
-    // Add a conditional check to the prelude to jump to this case.
-    builder_.SetInsertPoint(prelude_block);
-    auto cond_value = LLVMValueTransformer::Transform(context_, builder_, types_, symbols_, cache_, prelude_, *guard_case.first);
-    if (i < node.cases.size() - 1) {
-      // Create and branch to the next possible case if this case's check fails.
-      // All blocks' terminators must have a defined control flow.
-      auto next_prelude = llvm::BasicBlock::Create(context_, "check");
-      builder_.CreateCondBr(cond_value, case_block, next_prelude);
-      parent_func->getBasicBlockList().push_back(next_prelude);
-      prelude_block = next_prelude;
+  for (size_t i = 0; i < node.cases.size(); i++) {
+    auto& guard_case = node.cases[i];
+    auto case_block = llvm::BasicBlock::Create(context_, "case", parent_func);
+
+    if (i < switch_cases) {
+      int64_t literal;
+      MatchLiteralComparison(*guard_case.first, literal);
+      switch_inst->addCase(builder_.getInt64(literal), case_block);
+
+      // Continue checking any remaining cases from the default block.
+      if (i == switch_cases - 1 && switch_inst->getDefaultDest() != wildcard_block) {
+        prelude_block = switch_inst->getDefaultDest();
+        parent_func->getBasicBlockList().push_back(prelude_block);
+      }
     } else {
-      // When we reach the last case, branch to the wildcard case.
-      builder_.CreateCondBr(cond_value, case_block, wildcard_block);
+      // Add a conditional check to the prelude to jump to this case.
+      builder_.SetInsertPoint(prelude_block);
+      if (function_.liveness) {
+        DropDead(builder_, function_, prelude_, refcounter_, function_.liveness->LiveIn(*guard_case.first), false);
+      }
+      auto cond_value = TransformChild(*guard_case.first);
+      if (i < node.cases.size() - 1) {
+        // Create and branch to the next possible case if this case's check fails.
+        // All blocks' terminators must have a defined control flow.
+        auto next_prelude = llvm::BasicBlock::Create(context_, "check");
+        builder_.CreateCondBr(cond_value, case_block, next_prelude);
+        parent_func->getBasicBlockList().push_back(next_prelude);
+        prelude_block = next_prelude;
+      } else {
+        // When we reach the last case, branch to the wildcard case.
+        builder_.CreateCondBr(cond_value, case_block, wildcard_block);
+      }
     }
+
+    // Compute the expression value in the case block and branch to the
+    // terminator. Later checks continue with the locals owned before it.
+    LocalSet owned = function_.owned;
+    builder_.SetInsertPoint(case_block);
+    function_.reuse = reuse;
+    if (function_.liveness) {
+      DropDead(builder_, function_, prelude_, refcounter_, function_.liveness->LiveIn(*guard_case.second), true);
+    }
+    auto expr_value = tail ? TransformTailChild(*guard_case.second, tail_union) : TransformChild(*guard_case.second);
+    if (!tail) {
+      expr_value = Inject(expr_value, TypeOf(*guard_case.second), TypeOf(node), stack_cell);
+      ReleaseReuse();
+      // The case expression may have ended in a different block, e.g. the
+      // terminal block of a nested guard.
+      phi_node->addIncoming(expr_value, builder_.GetInsertBlock());
+      builder_.CreateBr(terminal_block);
+    }
+    function_.owned = std::move(owned);
+    function_.reuse.clear();
   }
 
   // Generate the wildcard (else) block.
+  parent_func->getBasicBlockList().push_back(wildcard_block);
   builder_.SetInsertPoint(wildcard_block);
-  auto wildcard_value = LLVMValueTransformer::Transform(context_, builder_, types_, symbols_, cache_, prelude_, *node.wildcard_case);
-  phi_node->addIncoming(wildcard_value, wildcard_block);
+  function_.reuse = std::move(reuse);
+  if (function_.liveness) {
+    DropDead(builder_, function_, prelude_, refcounter_, function_.liveness->LiveIn(*node.wildcard_case), true);
+  }
+  auto wildcard_value = tail ? TransformTailChild(*node.wildcard_case, tail_union) : TransformChild(*node.wildcard_case);
+  if (tail) {
+    function_.reuse.clear();
+    return false;
+  }
+  wildcard_value = Inject(wildcard_value, TypeOf(*node.wildcard_case), TypeOf(node), stack_cell);
+  ReleaseReuse();
+  phi_node->addIncoming(wildcard_value, builder_.GetInsertBlock());
   builder_.CreateBr(terminal_block);
-  parent_func->getBasicBlockList().push_back(wildcard_block);
 
   parent_func->getBasicBlockList().push_back(terminal_block);
 
   builder_.SetInsertPoint(terminal_block);
 
+  // Every case produces the same cell in the frame.
+  if (stack_cell) {
+    phi_node->eraseFromParent();
+    value_ = stack_cell;
+    return false;
+  }
   value_ = phi_node;
   return false;
 }
 
+llvm::Value* LLVMValueTransformer::Coerce(llvm::Value* value, llvm::Type* type) {
+  if (value->getType() == type) {
+    return value;
+  }
+  // Equivalent recursive types rooted at different components are lowered
+  // to distinct, but identically laid out, structs.
+  assert(value->getType()->isPointerTy() && type->isPointerTy());
+  return builder_.CreateBitCast(value, type);
+}
+
+llvm::Value* LLVMValueTransformer::Inject(llvm::Value* value, typing::Type& type, typing::Type& union_type,
+                                          llvm::Value* cell) {
+  llvm::Type* llvm_type = LLVMTypeGenerator::Generate(context_, union_type, cache_);
+  auto disjoint = dynamic_cast<typing::DisjointUnion*>(&union_type);
+  if (!disjoint || type.Hash() == union_type.Hash()) {
+    return Coerce(value, llvm_type);
+  }
+
+  auto layout = cache_.LookupDisjoint(union_type);
+  assert(layout);
+  for (unsigned int i = 0; i < disjoint->types().size(); i++) {
+    std::vector<std::pair<const typing::Type*, const typing::Type*>> assumed;
+    if (!Equivalent(*disjoint->types()[i], type, assumed)) {
+      continue;
+    }
+    // Members referring back to the union are held by pointer, even where the
+    // same type is otherwise passed by value, and so are boxed on the heap.
+    if (layout->members[i]->isPointerTy() && value->getType()->isStructTy()) {
+      auto box_type = llvm::cast<llvm::StructType>(cache_.Lookup(*disjoint->types()[i]));
+      auto box = prelude_.CreateHeapAlloc(builder_, box_type, TakeReuse(box_type));
+      for (unsigned int field = 0; field < box_type->getNumElements(); field++) {
+        builder_.CreateStore(Coerce(builder_.CreateExtractValue(value, field), box_type->getElementType(field)),
+                             builder_.CreateStructGEP(box_type, box, field));
+      }
+      value = box;
+    }
+    value = Coerce(value, layout->members[i]);
+    if (!llvm_type->isPointerTy() || cache_.LookupTaggedRef(llvm_type)) {
+      return LLVMDisjoint::CreateInject(builder_, llvm_type, *layout, i, value);
+    }
+    // Recursive unions with members passed by value are referenced by
+    // pointer, so the member is stored in a cell of its own on the heap,
+    // unless given one.
+    auto cell_type = llvm::cast<llvm::StructType>(cache_.Lookup(union_type));
+    if (!cell) {
+      cell = prelude_.CreateHeapAlloc(builder_, cell_type, TakeReuse(cell_type));
+    }
+    LLVMDisjoint::CreateStore(builder_, cell_type, *layout, i, value, cell);
+    return cell;
+  }
+  assert(false);
+  return nullptr;
+}
+
 bool LLVMValueTransformer::Bind(ast::BindNode& node) {
-  auto expr_value = LLVMValueTransformer::Transform(context_, builder_, types_, symbols_, cache_, prelude_, *node.expr);
+  auto expr_value = TransformChild(*node.expr);
 
-  SymbolTable scoped_table(symbols_);
-  // TODO(acomminos): enforce identifier override?
-  scoped_table.Assign(node.identifier, expr_value);
+  assert(node.local >= 0 && static_cast<size_t>(node.local) < function_.locals.size());
+  function_.locals[node.local] = expr_value;
+  if (function_.liveness) {
+    function_.owned[node.local] = refcounter_.IsCounted(expr_value->getType()) &&
+                                  !function_.borrowed.count(expr_value);
+    DropDead(builder_, function_, prelude_, refcounter_, function_.liveness->LiveIn(*node.body), true);
+  }
 
-  value_ = LLVMValueTransformer::Transform(context_, builder_, types_, scoped_table, cache_, prelude_, *node.body);
+  value_ = TransformTailChild(*node.body);
   return false;
 }
 
 bool LLVMValueTransformer::Tuple(ast::TupleNode& node) {
-  llvm::Type* tuple_type = LLVMTypeGenerator::Generate(context_, types_[node.id], cache_);
+  llvm::Type* tuple_type = LLVMTypeGenerator::Generate(context_, TypeOf(node), cache_);
   assert(tuple_type);
 
+  if (IsTailRecursiveCons(node, tuple_type)) {
+    return TailRecursiveCons(node, tuple_type);
+  }
+
+  // Non-recursive tuples are passed by value, and can be built up as an SSA
+  // aggregate without touching memory. Tuples of constants are constant
+  // themselves.
+  llvm::StructType* struct_type = cache_.HeapCell(tuple_type);
+  if (!struct_type) {
+    std::vector<llvm::Value*> fields(node.items.size());
+    std::vector<llvm::Constant*> constant_fields;
+    for (unsigned int i = 0; i < node.items.size(); i++) {
+      unsigned int field = cache_.FieldIndex(tuple_type, i);
+      fields[field] = Coerce(TransformItem(*std::get<ast::NodePtr>(node.items[i])),
+                             tuple_type->getStructElementType(field));
+    }
+    for (auto field_value : fields) {
+      if (auto constant = llvm::dyn_cast<llvm::Constant>(field_value)) {
+        constant_fields.push_back(constant);
+      }
+    }
+    if (constant_fields.size() == fields.size()) {
+      value_ = llvm::ConstantStruct::get(llvm::cast<llvm::StructType>(tuple_type), constant_fields);
+      return false;
+    }
+
+    llvm::Value* aggregate = llvm::UndefValue::get(tuple_type);
+    for (unsigned int i = 0; i < fields.size(); i++) {
+      aggregate = builder_.CreateInsertValue(aggregate, fields[i], i);
+    }
+    value_ = aggregate;
+    return false;
+  }
+
+  // Recursive types are passed by pointer, and so must live on the heap,
+  // unless they do not outlive this function's frame.
   llvm::Value* struct_addr;
-  if (auto* ptr_type = llvm::dyn_cast<llvm::PointerType>(tuple_type)) {
-    // TODO/FIXME(acomminos): make a call to malloc() for tuples yielding a
-    //                        pointer type
-    struct_addr = prelude_.CreateHeapAlloc(builder_, ptr_type->getElementType());
+  if (options_.stack_allocation && !function_.escapes->Escapes(node)) {
+    auto& entry_block = builder_.GetInsertBlock()->getParent()->getEntryBlock();
+    llvm::IRBuilder<> entry_builder(&entry_block, entry_block.begin());
+    struct_addr = entry_builder.CreateAlloca(struct_type);
+    function_.stack.insert(struct_addr);
   } else {
-    struct_addr = builder_.CreateAlloca(tuple_type);
+    struct_addr = prelude_.CreateHeapAlloc(builder_, struct_type, TakeReuse(struct_type));
+  }
+  for (unsigned int i = 0; i < node.items.size(); i++) {
+    auto item_value = TransformItem(*std::get<ast::NodePtr>(node.items[i]));
+    unsigned int field = cache_.FieldIndex(struct_type, i);
+    llvm::Value* item_addr = builder_.CreateStructGEP(struct_type, struct_addr, field);
+    builder_.CreateStore(Coerce(item_value, struct_type->getStructElementType(field)), item_addr);
   }
+  value_ = struct_addr;
 
-  unsigned int tuple_offset = 0;
-  for (auto& item : node.items) {
-    auto& node = std::get<ast::NodePtr>(item);
-    auto item_value = LLVMValueTransformer::Transform(context_, builder_, types_, symbols_, cache_, prelude_, *node);
-    // TODO(acomminos): fetch tuple element pointers in aggregate
-    llvm::Value* item_addr = builder_.CreateStructGEP(struct_addr, tuple_offset++);
-    builder_.CreateStore(item_value, item_addr);
+  return false;
+}
+
+bool LLVMValueTransformer::IsTailRecursiveCons(ast::TupleNode& node, llvm::Type* tuple_type) const {
+  // Destination-passing functions rely on guaranteed tail calls to recurse in
+  // constant stack space.
+  if (!tail_ || function_.func->getCallingConv() != llvm::CallingConv::Tail) {
+    return false;
   }
 
-  // Return a pointer iff the type is recursive (passed by pointer).
-  if (tuple_type->isPointerTy()) {
-    value_ = struct_addr;
-  } else {
-    value_ = builder_.CreateLoad(struct_addr);
+  auto struct_type = cache_.HeapCell(tuple_type);
+  if (!struct_type || node.items.empty()) {
+    return false;
+  }
+
+  auto& last_item = std::get<ast::NodePtr>(node.items.back());
+  auto call = dynamic_cast<ast::InvocationNode*>(last_item.get());
+  if (!call) {
+    return false;
+  }
+  auto callee = LookupCallee(*call);
+  if (!callee || !IsSelf(callee)) {
+    return false;
+  }
+
+  // The recursive call's result must be storable in the last field, which
+  // holds the function's own result type (e.g. the union of a list's cells,
+  // when the tuple is one of its members).
+  unsigned int last_field = cache_.FieldIndex(struct_type, node.items.size() - 1);
+  auto tuple = dynamic_cast<typing::Tuple*>(&TypeOf(node));
+  if (!tuple || !struct_type->getElementType(last_field)->isPointerTy()) {
+    return false;
+  }
+  auto& last_type = std::get<std::unique_ptr<typing::Type>>(tuple->types().back());
+  std::vector<std::pair<const typing::Type*, const typing::Type*>> assumed;
+  return Equivalent(*last_type, TypeOf(*call), assumed);
+}
+
+llvm::Function* LLVMValueTransformer::GetDestinationPassingFunction() {
+  if (function_.dps_func) {
+    return function_.dps_func;
+  }
+
+  auto func = function_.func;
+  std::vector<llvm::Type*> param_types(func->getFunctionType()->param_begin(),
+                                       func->getFunctionType()->param_end());
+  param_types.push_back(func->getReturnType()->getPointerTo());
+  auto func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context_), param_types, false);
+
+  auto dps_func = llvm::Function::Create(func_type, llvm::Function::InternalLinkage,
+                                         func->getName() + "_dps", func->getParent());
+  dps_func->setCallingConv(llvm::CallingConv::Tail);
+  // Arguments are passed the same way as to the function itself. Its result
+  // is always a pointer, so is never returned through memory.
+  if (auto abi = cache_.LookupABI(func->getFunctionType())) {
+    cache_.InsertABI(func_type, *abi);
+    abi->AddAttributes(dps_func);
+  }
+  LLVMDeclarationTransformer::AddPointerAttributes(dps_func, cache_);
+  function_.dps_func = dps_func;
+  return dps_func;
+}
+
+bool LLVMValueTransformer::TailRecursiveCons(ast::TupleNode& node, llvm::Type* tuple_type) {
+  auto struct_type = cache_.HeapCell(tuple_type);
+  auto struct_addr = prelude_.CreateHeapAlloc(builder_, struct_type, TakeReuse(struct_type));
+
+  // Fill in all but the last item, which is written by the recursive call.
+  for (unsigned int i = 0; i < node.items.size() - 1; i++) {
+    auto item_value = TransformItem(*std::get<ast::NodePtr>(node.items[i]));
+    unsigned int field = cache_.FieldIndex(struct_type, i);
+    llvm::Value* item_addr = builder_.CreateStructGEP(struct_type, struct_addr, field);
+    builder_.CreateStore(Coerce(item_value, struct_type->getStructElementType(field)), item_addr);
+  }
+
+  // Members of a returned union are wrapped into it (e.g. by tagging a
+  // reference to the cell), giving the function's result.
+  llvm::Type* result_type = function_.func->getReturnType();
+  llvm::Value* result = struct_addr;
+  if (tail_union_) {
+    result = Inject(struct_addr, TypeOf(node), *tail_union_);
+  }
+  result = Coerce(result, result_type);
+
+  // In a destination-passing function, the result fills the hole left by
+  // the previous iteration.
+  if (function_.dest) {
+    builder_.CreateStore(result, function_.dest);
   }
 
+  auto& call_node = static_cast<ast::InvocationNode&>(*std::get<ast::NodePtr>(node.items.back()));
+  std::vector<llvm::Value*> arg_values;
+  for (auto& expr : call_node.args) {
+    arg_values.push_back(TransformChild(*expr));
+  }
+  bool allow_tail = true;
+  auto borrowed_args = BorrowedArgs(call_node.callee, arg_values, allow_tail);
+  auto dps_func = GetDestinationPassingFunction();
+  LowerArguments(dps_func->getFunctionType(), arg_values);
+  unsigned int last_field = cache_.FieldIndex(struct_type, node.items.size() - 1);
+  arg_values.push_back(Coerce(builder_.CreateStructGEP(struct_type, struct_addr, last_field),
+                              result_type->getPointerTo()));
+
+  ReleaseReuse();
+  auto call = builder_.CreateCall(dps_func, arg_values);
+  call->setCallingConv(llvm::CallingConv::Tail);
+  if (auto abi = cache_.LookupABI(dps_func->getFunctionType())) {
+    abi->AddAttributes(call);
+  }
+  for (auto arg_value : borrowed_args) {
+    Drop(builder_, function_, refcounter_, arg_value);
+  }
+  if (function_.dest) {
+    if (allow_tail) {
+      call->setTailCallKind(llvm::CallInst::TCK_Tail);
+    }
+    builder_.CreateRetVoid();
+  } else {
+    builder_.CreateRet(result);
+  }
+  value_ = result;
   return false;
 }
 
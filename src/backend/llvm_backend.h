@@ -3,48 +3,151 @@
 
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 
 #include "ast/types.h"
 #include "ast/util.h"
+#include "backend/escape.h"
+#include "backend/liveness.h"
+#include "backend/llvm_constants.h"
+#include "backend/llvm_folder.h"
 #include "typing/function_specializer.h"
+#include "typing/type_registry.h"
 #include "util/scoped_map.h"
 
 namespace darlang {
 namespace backend {
 
-// Scoped symbol table for arguments, bindings, and functions.
+// Scoped symbol table for functions.
 typedef util::ScopedMap<std::string, llvm::Value*> SymbolTable;
+// The function (or alias) implementing each specialization.
+typedef std::unordered_map<const typing::Specialization*, llvm::Value*> FunctionTable;
+// Values of a function's arguments and bindings, indexed by the local slots
+// assigned by scoping::ScopeTransform.
+typedef std::vector<llvm::Value*> ValueLocals;
+
+// Heap storage released on the current path, which may be reused by the next
+// allocation of the same size. Null if the released value was still shared.
+struct ReuseToken {
+  uint64_t size;
+  llvm::Value* block;
+};
+
+// State of a function body under transformation, shared by its expressions.
+struct FunctionState {
+  FunctionState(llvm::Function* func, int num_locals)
+    : func(func), callees(nullptr), constants(nullptr), locals(num_locals), owned(num_locals), liveness(nullptr)
+    , escapes(nullptr), dest(nullptr), sret(nullptr), dps_func(nullptr) {}
+
+  // The specialization being generated.
+  llvm::Function* func;
+  // The specializations called by the function, by call site.
+  const typing::CalleeTable* callees;
+  // Literals and named constants shared across the module.
+  LLVMConstantPool* constants;
+  ValueLocals locals;
+  // Locals holding a reference owned by the function, to be moved on their
+  // last use or dropped once dead.
+  LocalSet owned;
+  // Storage released on the current path, available for reuse.
+  std::vector<ReuseToken> reuse;
+  // Liveness of the declaration's locals, or nullptr if values are not
+  // reference counted.
+  const Liveness* liveness;
+  const EscapeAnalysis* escapes;
+  // Values borrowed from the caller, which the function must not release.
+  std::unordered_set<llvm::Value*> borrowed;
+  // Tuples and union cells allocated in the function's stack frame rather
+  // than the heap.
+  std::unordered_set<llvm::Value*> stack;
+  // When generating the destination-passing variant of `func`, the slot its
+  // result is stored to rather than returned.
+  llvm::Value* dest;
+  // The caller's slot for the function's result, if it is too large to be
+  // returned directly.
+  llvm::Value* sret;
+  // The destination-passing variant of `func`, created on demand to implement
+  // tail recursion modulo cons.
+  llvm::Function* dps_func;
+};
 
 class LLVMPrelude;
+class LLVMRefCounter;
 class LLVMTypeCache;
 
+// Controls when guards are lowered to a chain of selects in a single block,
+// rather than branching to a block per case.
+enum class GuardSelect {
+  AUTO,    // when all cases are pure, and cheap enough to evaluate eagerly
+  ALWAYS,  // whenever all cases are safe to evaluate eagerly
+  NEVER,
+};
+
+// Code generation choices exposed for tuning and benchmarking.
+struct LLVMBackendOptions {
+  GuardSelect guard_select = GuardSelect::AUTO;
+  // If true, heap values are reference counted, and freed or reused in place
+  // once their last reference is dropped.
+  bool reference_counting = true;
+  // If true, recursive tuples that do not escape the function building them
+  // are allocated on the stack.
+  bool stack_allocation = true;
+  // If true, specializations are private to the module, leaving only its
+  // entry points (i.e. main) visible to the linker.
+  bool internalize = true;
+  // Tuples larger than this many bytes are passed to and returned from
+  // specializations through memory. See LLVMTarget::MaxDirectAggregateSize.
+  uint64_t max_direct_aggregate_size = 16;
+};
+
 class LLVMModuleTransformer : public ast::Visitor {
  public:
   // Transforms the given AST node (presumed to be a module) into an
   // llvm::Module. Requires the result of a type synthesis pass.
   //
+  // The data layout should match that of the target the module will be
+  // compiled for, as it determines the size of heap allocations.
+  //
   // Returns nullptr on failure.
-  static std::unique_ptr<llvm::Module> Transform(llvm::LLVMContext& context, typing::SpecializationMap& specs, ast::Node& node);
+  static std::unique_ptr<llvm::Module> Transform(llvm::LLVMContext& context,
+                                                 typing::SpecializationMap& specs,
+                                                 ast::Node& node,
+                                                 const llvm::DataLayout& layout = llvm::DataLayout(""),
+                                                 const LLVMBackendOptions& options = LLVMBackendOptions());
 
   bool Module(ast::ModuleNode& node) override;
  private:
-  LLVMModuleTransformer(llvm::LLVMContext& context, typing::SpecializationMap& specs)
-    : context_(context), specs_(specs) {}
+  LLVMModuleTransformer(llvm::LLVMContext& context, typing::SpecializationMap& specs,
+                        const llvm::DataLayout& layout, const LLVMBackendOptions& options)
+    : context_(context), specs_(specs), layout_(layout), options_(options) {}
 
   llvm::LLVMContext& context_;
   std::unique_ptr<llvm::Module> module_;
   typing::SpecializationMap& specs_;
+  const llvm::DataLayout& layout_;
+  const LLVMBackendOptions& options_;
 };
 
 // Transforms top-level function and constant declarations in a module.
-// Writes traversed function definitions to the provided symbol table.
+// Writes traversed function definitions to the provided symbol table, and the
+// function implementing each specialization to the function table. Constants
+// are evaluated into globals.
 class LLVMDeclarationTransformer : public ast::Visitor {
  public:
-  LLVMDeclarationTransformer(llvm::Module* module, typing::SpecializationMap& specs, SymbolTable& symbols, LLVMTypeCache& cache)
-    : module_(module), specs_(specs), symbols_(symbols), cache_(cache) {}
+  LLVMDeclarationTransformer(llvm::Module* module, typing::SpecializationMap& specs, const FoldMap& folds,
+                             SymbolTable& symbols, FunctionTable& functions, LLVMConstantEvaluator& evaluator,
+                             LLVMTypeCache& cache, const LLVMBackendOptions& options)
+    : module_(module), specs_(specs), folds_(folds), symbols_(symbols), functions_(functions)
+    , evaluator_(evaluator), cache_(cache), options_(options) {}
+
+  // Marks pointers to heap cells passed to or returned from a function as
+  // non-null and dereferenceable, as they always point to a live cell. Must be
+  // called after any ABI attributes are added, whose pointers are left as is.
+  static void AddPointerAttributes(llvm::Function* func, LLVMTypeCache& cache);
 
  private:
   bool Declaration(ast::DeclarationNode& node) override;
@@ -52,8 +155,12 @@ class LLVMDeclarationTransformer : public ast::Visitor {
 
   llvm::Module* module_;
   typing::SpecializationMap& specs_;
+  const FoldMap& folds_;
   SymbolTable& symbols_;
+  FunctionTable& functions_;
+  LLVMConstantEvaluator& evaluator_;
   LLVMTypeCache& cache_;
+  const LLVMBackendOptions& options_;
 };
 
 // Generates function bodies.
@@ -61,20 +168,37 @@ class LLVMFunctionTransformer : public ast::Visitor {
  public:
   LLVMFunctionTransformer(llvm::LLVMContext& context,
                           typing::SpecializationMap& specs,
-                          const SymbolTable& symbols,
+                          const FoldMap& folds,
+                          const FunctionTable& functions,
+                          LLVMConstantPool& constants,
                           LLVMTypeCache& cache,
-                          LLVMPrelude& prelude)
-    : context_(context), specs_(specs), symbols_(symbols), cache_(cache)
-    , prelude_(prelude) {}
+                          LLVMPrelude& prelude,
+                          LLVMRefCounter& refcounter,
+                          const EscapeAnalysis& escapes,
+                          const LLVMBackendOptions& options)
+    : context_(context), specs_(specs), folds_(folds), functions_(functions), constants_(constants)
+    , cache_(cache), prelude_(prelude), refcounter_(refcounter), escapes_(escapes)
+    , options_(options) {}
 
  private:
   bool Declaration(ast::DeclarationNode& node) override;
 
+  // Generates the body of a specialization into a function.
+  void Body(ast::DeclarationNode& node,
+            const typing::Specialization& spec,
+            FunctionState& function,
+            llvm::Function* func);
+
   llvm::LLVMContext& context_;
   typing::SpecializationMap& specs_;
-  const SymbolTable& symbols_;
+  const FoldMap& folds_;
+  const FunctionTable& functions_;
+  LLVMConstantPool& constants_;
   LLVMTypeCache& cache_;
   LLVMPrelude& prelude_;
+  LLVMRefCounter& refcounter_;
+  const EscapeAnalysis& escapes_;
+  const LLVMBackendOptions& options_;
 };
 
 // Transforms AST nodes representing an expression into a llvm::Value* within
@@ -83,17 +207,49 @@ class LLVMFunctionTransformer : public ast::Visitor {
 // Each visitor method is expected to produce instructions in one basic block,
 // and leave the IRBuilder tracking a single open-ended basic block through
 // which all control flow must route through.
+//
+// Expressions in tail position (whose value is returned from the function)
+// instead return their value directly from every path, leaving the IRBuilder
+// in a terminated block. Calls in tail position are emitted as tail calls.
+//
+// When reference counting, every expression produces an owned reference to
+// its value. Locals are moved out of on their last use, and dropped as soon as
+// they die (see Liveness), so that the storage of a uniquely referenced value
+// can be reused by a tuple built on the same path.
 class LLVMValueTransformer : public ast::Visitor {
  public:
   static llvm::Value* Transform(llvm::LLVMContext& context,
                                 llvm::IRBuilder<>& builder,
-                                typing::TypeableMap& types,
-                                const SymbolTable& symbols,
+                                const typing::TypeTable& types,
+                                const typing::TypeRegistry& registry,
+                                const FunctionTable& functions,
+                                FunctionState& function,
                                 LLVMTypeCache& cache,
                                 LLVMPrelude& prelude,
-                                ast::Node& node);
+                                LLVMRefCounter& refcounter,
+                                const LLVMBackendOptions& options,
+                                ast::Node& node,
+                                bool tail = false,
+                                typing::Type* tail_union = nullptr);
+
+  // Returns the calling convention used by a declaration's specializations.
+  // Exported (polymorphic) functions use a convention guaranteeing tail calls
+  // between them, while monomorphic entry points (e.g. main) retain the C
+  // calling convention.
+  static llvm::CallingConv::ID CallingConv(const ast::DeclarationNode& decl);
+
+  // Drops the references held by a function's owned locals that are not
+  // live. If `reuse` is set, the storage of uniquely referenced heap values
+  // is made available for reuse on the current path.
+  static void DropDead(llvm::IRBuilder<>& builder, FunctionState& function,
+                       LLVMPrelude& prelude, LLVMRefCounter& refcounter,
+                       const LocalSet& live, bool reuse);
+  // Releases a reference to a value, unless it is borrowed.
+  static void Drop(llvm::IRBuilder<>& builder, FunctionState& function,
+                   LLVMRefCounter& refcounter, llvm::Value* value);
 
   bool IdExpression(ast::IdExpressionNode& node) override;
+  bool ConstantExpression(ast::ConstantExpressionNode& node) override;
   bool IntegralLiteral(ast::IntegralLiteralNode& node) override;
   bool StringLiteral(ast::StringLiteralNode& node) override;
   bool BooleanLiteral(ast::BooleanLiteralNode& node) override;
@@ -106,22 +262,116 @@ class LLVMValueTransformer : public ast::Visitor {
 
  private:
   LLVMValueTransformer(llvm::LLVMContext& context, llvm::IRBuilder<>& builder,
-                       typing::TypeableMap& types, const SymbolTable& symbols,
-                       LLVMTypeCache& cache, LLVMPrelude& prelude)
+                       const typing::TypeTable& types,
+                       const typing::TypeRegistry& registry,
+                       const FunctionTable& functions,
+                       FunctionState& function,
+                       LLVMTypeCache& cache, LLVMPrelude& prelude,
+                       LLVMRefCounter& refcounter,
+                       const LLVMBackendOptions& options,
+                       bool tail,
+                       typing::Type* tail_union)
     : context_(context)
     , builder_(builder)
     , types_(types)
-    , symbols_(symbols)
+    , registry_(registry)
+    , functions_(functions)
+    , function_(function)
     , cache_(cache)
     , prelude_(prelude)
+    , refcounter_(refcounter)
+    , options_(options)
+    , tail_(tail)
+    , tail_union_(tail_union)
     , value_(nullptr) {}
 
+  // Transforms a child expression within the same function.
+  llvm::Value* TransformChild(ast::Node& node);
+  // Transforms a child expression whose value is returned from the function,
+  // if this expression is also in tail position. Its value is wrapped into
+  // `tail_union` before returning, if given, or else the union this
+  // expression's value is wrapped into.
+  llvm::Value* TransformTailChild(ast::Node& node, typing::Type* tail_union = nullptr);
+  // Transforms an item to be stored in a tuple, which owns a reference to it.
+  llvm::Value* TransformItem(ast::Node& node);
+  // Emits a call to a function symbol, which may be an alias of a folded
+  // specialization, returning its result. Calls in tail position are marked as
+  // tail calls where the callee's calling convention allows.
+  llvm::Value* CreateCall(llvm::Value* callee, const std::vector<llvm::Value*>& args,
+                          bool allow_tail = true);
+  // Copies arguments passed through memory into slots in the current frame,
+  // to be passed by pointer to a function of the given type.
+  void LowerArguments(llvm::FunctionType* func_type, std::vector<llvm::Value*>& args);
+  // Returns a new slot for a value of the given type in the function's frame.
+  llvm::Value* CreateSlot(llvm::Type* type);
+  // Returns the arguments of a call that the callee only borrows, which the
+  // caller must release once it returns. Clears `allow_tail` if the call may
+  // not be a tail call, as it borrows from this function's frame or leaves
+  // references to release.
+  std::vector<llvm::Value*> BorrowedArgs(const std::string& callee,
+                                         const std::vector<llvm::Value*>& args,
+                                         bool& allow_tail) const;
+  // Returns the function symbol called by an invocation, or nullptr if it
+  // invokes an intrinsic.
+  llvm::Value* LookupCallee(ast::InvocationNode& node) const;
+  // Returns true if a function symbol refers to the function being generated.
+  bool IsSelf(llvm::Value* callee) const;
+
+  // Returns true if a tuple in tail position can be built with tail recursion
+  // modulo cons, i.e. it is heap allocated and its last item is a recursive
+  // call. Such tuples are filled in by the destination-passing variant of the
+  // function, which writes its result into the tuple's last field, rather
+  // than being constructed after the call returns.
+  bool IsTailRecursiveCons(ast::TupleNode& node, llvm::Type* tuple_type) const;
+  // Returns the destination-passing variant of the function being generated,
+  // taking an additional pointer to the slot its result is stored in.
+  llvm::Function* GetDestinationPassingFunction();
+  // Builds a tuple with tail recursion modulo cons.
+  bool TailRecursiveCons(ast::TupleNode& node, llvm::Type* tuple_type);
+
+  // Returns the storage of a released value suitable for allocating a heap
+  // value of the given type, or nullptr if there is none.
+  llvm::Value* TakeReuse(llvm::Type* type);
+  // Frees any released storage not reused on the current path.
+  void ReleaseReuse();
+
+  // Returns true if a (speculatable) expression reads a counted value, which
+  // would need to be released on every path not taken.
+  bool ReadsCounted(ast::Node& node);
+  // Returns true if a guard should be evaluated eagerly as a chain of selects.
+  bool ShouldSelect(ast::GuardNode& node);
+  // Lowers a guard to a chain of selects within the current block.
+  bool GuardSelect(ast::GuardNode& node);
+  // Wraps a value into a disjoint union type it is a member of. Values of any
+  // other (equivalent) type are only converted to its representation. Members
+  // of recursive unions are stored to `cell` if given, rather than a new cell
+  // on the heap.
+  llvm::Value* Inject(llvm::Value* value, typing::Type& type, typing::Type& union_type,
+                      llvm::Value* cell = nullptr);
+  // Converts a value to an equivalent LLVM type, i.e. a pointer to another
+  // lowering of the same recursive type.
+  llvm::Value* Coerce(llvm::Value* value, llvm::Type* type);
+
+  // Returns the solved type of a node within the current specialization.
+  typing::Type& TypeOf(const ast::Node& node) const {
+    return registry_.Get(types_.at(node.id));
+  }
+
   llvm::LLVMContext& context_;
   llvm::IRBuilder<>& builder_;
-  typing::TypeableMap& types_;
-  const SymbolTable& symbols_;
+  const typing::TypeTable& types_;
+  const typing::TypeRegistry& registry_;
+  const FunctionTable& functions_;
+  FunctionState& function_;
   LLVMTypeCache& cache_;
   LLVMPrelude& prelude_;
+  LLVMRefCounter& refcounter_;
+  const LLVMBackendOptions& options_;
+  // True if the value of this expression is returned from the function.
+  const bool tail_;
+  // The disjoint union returned by the function, if the value of this tail
+  // expression is one of its members and must be wrapped into it first.
+  typing::Type* const tail_union_;
 
   llvm::Value* value_;
 };
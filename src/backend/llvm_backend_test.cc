@@ -0,0 +1,791 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+
+#include "backend/llvm_backend.h"
+#include "backend/llvm_jit.h"
+#include "parsing/lexer.h"
+#include "parsing/parser.h"
+#include "scoping/scope_transform.h"
+#include "runtime/runtime.h"
+#include "typing/module_specializer.h"
+
+namespace darlang {
+namespace backend {
+
+// Compiles a darlang program into a verified LLVM module.
+static std::unique_ptr<llvm::Module> Compile(llvm::LLVMContext& context, const std::string& program,
+                                             const LLVMBackendOptions& options = LLVMBackendOptions(),
+                                             const llvm::DataLayout& layout = llvm::DataLayout("")) {
+  std::stringstream source(program);
+
+  Logger log(std::cerr);
+  parsing::Lexer lexer(log, source, "test");
+  parsing::TokenStream tokens(lexer);
+  parsing::Parser parser(log, tokens);
+  auto module = parser.ParseModule();
+  scoping::ScopeTransform::Resolve(log, *module);
+
+  typing::ModuleSpecializer specializer(log, true);
+  auto& specs = specializer.Specialize(*module);
+
+  auto llvm_module = LLVMModuleTransformer::Transform(context, specs, *module, layout, options);
+  REQUIRE(!llvm::verifyModule(*llvm_module, &llvm::errs()));
+  return llvm_module;
+}
+
+// Returns the exit status of compiling a program in a child process, as
+// errors that block compilation exit the process.
+static int CompileStatus(const std::string& program) {
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    llvm::LLVMContext context;
+    Compile(context, program);
+    _exit(0);
+  }
+  int status = 0;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  REQUIRE(WIFEXITED(status));
+  return WEXITSTATUS(status);
+}
+
+// A program compiled for the host, whose `main` can be run in-process. Its
+// static data (e.g. strings referenced by its results) lives as long as the
+// JIT does.
+struct Program {
+  std::unique_ptr<LLVMJit> jit;
+  int64_t (*main)();
+};
+
+// Replaces the program's `main` with one returning the address of the value
+// produced by the nullary function `entry`, so that tests can inspect values
+// that `main` itself could not return. Results returned through memory are
+// stored to a global.
+static void ExposeEntry(llvm::Module& module, const std::string& entry) {
+  llvm::Function* callee = nullptr;
+  for (auto& func : module) {
+    if (func.getName().startswith(entry + "_")) {
+      callee = &func;
+    }
+  }
+  REQUIRE(callee);
+  auto main = module.getFunction("main");
+  main->setName("main.program");
+  main->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+  auto exposed = llvm::Function::Create(main->getFunctionType(), llvm::GlobalValue::ExternalLinkage, "main", module);
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(module.getContext(), "entry", exposed));
+  if (callee->hasParamAttribute(0, llvm::Attribute::StructRet)) {
+    auto result_type = callee->getParamStructRetType(0);
+    auto result = new llvm::GlobalVariable(module, result_type, false, llvm::GlobalValue::InternalLinkage,
+                                           llvm::Constant::getNullValue(result_type), "main.result");
+    auto call = builder.CreateCall(callee, {result});
+    call->setCallingConv(callee->getCallingConv());
+    call->addParamAttr(0, llvm::Attribute::getWithStructRetType(module.getContext(), result_type));
+    builder.CreateRet(builder.CreatePtrToInt(result, exposed->getReturnType()));
+    return;
+  }
+  auto call = builder.CreateCall(callee, {});
+  call->setCallingConv(callee->getCallingConv());
+  builder.CreateRet(builder.CreatePtrToInt(call, exposed->getReturnType()));
+}
+
+static Program Load(const std::string& program, const LLVMBackendOptions& options = LLVMBackendOptions(),
+                    const std::string& entry = "") {
+  auto jit = LLVMJit::Create(OptLevel::O0);
+  REQUIRE(jit);
+  auto context = std::make_unique<llvm::LLVMContext>();
+  auto module = Compile(*context, program, options, jit.value->layout());
+  if (!entry.empty()) {
+    ExposeEntry(*module, entry);
+  }
+  REQUIRE(jit.value->AddModule(std::move(module), std::move(context)));
+  auto main = jit.value->LookupMain();
+  REQUIRE(main);
+  return {std::move(jit.value), main.value};
+}
+
+// Builds a list of `n` copies of a string, as a recursive union.
+static const char* const kRepeat =
+    "repeat(str, i, n) -> {\n"
+    "  is(i, n) : ();\n"
+    "         * : (str, repeat(str, add(i, 1), n));\n"
+    "}\n";
+
+// The heap cells of lists built by kRepeat, as laid out for the host. A list
+// of type `() | (str, list)` is referenced by a pointer to its first cons
+// cell, or null when empty.
+struct ConsCell {
+  const char* item;
+  const ConsCell* rest;
+};
+
+// Returns the items of a list built by kRepeat, checking that each cell is
+// referenced once.
+static std::vector<std::string> ListItems(const ConsCell* list) {
+  std::vector<std::string> items;
+  for (; list; list = list->rest) {
+    REQUIRE(reinterpret_cast<const int64_t*>(list)[-1] == 1);
+    items.push_back(list->item);
+  }
+  return items;
+}
+
+// Builds a list as kRepeat does, but ended by `n` rather than the unit. Its
+// union of type `int | (str, list)` holds a member by value, and so keeps
+// cells of its own.
+static const char* const kTally =
+    "tally(str, i, n) -> {\n"
+    "  is(i, n) : n;\n"
+    "         * : (str, tally(str, add(i, 1), n));\n"
+    "}\n";
+
+// The heap cells of lists built by kTally, as laid out for the host.
+struct TallyCell {
+  uint8_t tag;
+  union {
+    int64_t end;
+    const struct TallyCons* cons;
+  };
+};
+struct TallyCons {
+  const char* item;
+  const TallyCell* rest;
+};
+
+// Returns the items of a list built by kTally, checking that each cell is
+// referenced once.
+static std::vector<std::string> TallyItems(const TallyCell* list) {
+  std::vector<std::string> items;
+  for (; list->tag == 1; list = list->cons->rest) {
+    REQUIRE(reinterpret_cast<const int64_t*>(list)[-1] == 1);
+    REQUIRE(reinterpret_cast<const int64_t*>(list->cons)[-1] == 1);
+    items.push_back(list->cons->item);
+  }
+  REQUIRE(list->tag == 0);
+  return items;
+}
+
+// Returns the calls made by a function.
+static std::vector<llvm::CallInst*> Calls(llvm::Function& func) {
+  std::vector<llvm::CallInst*> calls;
+  for (auto& block : func) {
+    for (auto& inst : block) {
+      if (auto call = llvm::dyn_cast<llvm::CallInst>(&inst)) {
+        calls.push_back(call);
+      }
+    }
+  }
+  return calls;
+}
+
+// Returns the number of calls made by a function to callees with a prefix.
+static int CallsTo(llvm::Function& func, const std::string& prefix) {
+  int count = 0;
+  for (auto call : Calls(func)) {
+    count += call->getCalledFunction()->getName().startswith(prefix);
+  }
+  return count;
+}
+
+TEST_CASE("recursive calls from guard cases are tail calls", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "count(n, limit) -> {\n"
+      "  is(n, limit) : n;\n"
+      "             * : x | add(n, 1); count(x, limit);\n"
+      "}\n"
+      "main() -> count(0, 10)\n");
+
+  auto count = module->getFunction("count_F2ii");
+  REQUIRE(count);
+  REQUIRE(count->getCallingConv() == llvm::CallingConv::Tail);
+
+  auto calls = Calls(*count);
+  REQUIRE(calls.size() == 1);
+  REQUIRE(calls[0]->isTailCall());
+  REQUIRE(calls[0]->getCallingConv() == llvm::CallingConv::Tail);
+
+  // main retains the C calling convention, and cannot guarantee a tail call.
+  auto main = module->getFunction("main");
+  REQUIRE(main->getCallingConv() == llvm::CallingConv::C);
+  REQUIRE(!Calls(*main)[0]->isTailCall());
+}
+
+TEST_CASE("recursive tuples are built with tail recursion modulo cons", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "nats(n) -> (n, nats(add(n, 1)))\n"
+      "main() -> x | nats(0); 0\n");
+
+  // The entry point allocates the first cell, and delegates filling in its
+  // tail to the destination-passing variant.
+  auto nats = module->getFunction("nats_F1i");
+  auto dps = module->getFunction("nats_F1i_dps");
+  REQUIRE(nats);
+  REQUIRE(dps);
+  REQUIRE(dps->getReturnType()->isVoidTy());
+  REQUIRE(dps->arg_size() == 2);
+
+  auto nats_calls = Calls(*nats);
+  REQUIRE(nats_calls.back()->getCalledFunction() == dps);
+  REQUIRE(!nats_calls.back()->isTailCall());
+
+  // The destination-passing variant loops through a tail call to itself.
+  auto dps_calls = Calls(*dps);
+  REQUIRE(dps_calls.back()->getCalledFunction() == dps);
+  REQUIRE(dps_calls.back()->isTailCall());
+}
+
+TEST_CASE("guards comparing a local to literals are lowered to a switch", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "classify(n, flag) -> {\n"
+      "  is(n, 1) : 10;\n"
+      "  is(2, n) : 20;\n"
+      "  flag : 5;\n"
+      "  is(n, 9) : 90;\n"
+      "  * : 0;\n"
+      "}\n"
+      "main() -> classify(2, is(1, 1))\n",
+      LLVMBackendOptions{GuardSelect::NEVER});
+
+  int switches = 0;
+  int branches = 0;
+  for (auto& block : *module->getFunction("classify_F2ib")) {
+    auto terminator = block.getTerminator();
+    if (auto switch_inst = llvm::dyn_cast<llvm::SwitchInst>(terminator)) {
+      switches++;
+      REQUIRE(switch_inst->getNumCases() == 2);
+    } else if (auto branch = llvm::dyn_cast<llvm::BranchInst>(terminator)) {
+      branches += branch->isConditional();
+    }
+  }
+
+  // The remaining mixed cases are checked in order from the default block.
+  REQUIRE(switches == 1);
+  REQUIRE(branches == 2);
+}
+
+TEST_CASE("cheap pure guards are lowered to selects", "[llvmbackend]") {
+  const std::string program =
+      "pick(n, a, b) -> {\n"
+      "  is(n, 0) : a;\n"
+      "  is(mod(n, 2), 1) : add(b, 1);\n"
+      "  * : b;\n"
+      "}\n"
+      "main() -> pick(3, 4, 5)\n";
+
+  auto selects = [](llvm::Function& func) {
+    int selects = 0;
+    for (auto& block : func) {
+      for (auto& inst : block) {
+        selects += llvm::isa<llvm::SelectInst>(inst);
+      }
+    }
+    return selects;
+  };
+
+  llvm::LLVMContext context;
+  auto module = Compile(context, program);
+  auto pick = module->getFunction("pick_F3iii");
+  REQUIRE(pick->size() == 1);
+  REQUIRE(selects(*pick) == 2);
+
+  // Selects can be disabled, falling back to a block per case.
+  auto branchy_module = Compile(context, program, LLVMBackendOptions{GuardSelect::NEVER});
+  auto branchy_pick = branchy_module->getFunction("pick_F3iii");
+  REQUIRE(branchy_pick->size() > 1);
+  REQUIRE(selects(*branchy_pick) == 0);
+}
+
+TEST_CASE("non-recursive tuples are built without memory", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "count(n) -> {\n"
+      "  is(n, 0) : 0;\n"
+      "  * : p | (n, add(n, 1)); count(mod(n, 2));\n"
+      "}\n"
+      "main() -> count(3)\n");
+
+  // The tuple is built outside of the entry block, where an alloca could not
+  // be promoted to registers.
+  int inserts = 0;
+  for (auto& block : *module->getFunction("count_F1i")) {
+    for (auto& inst : block) {
+      REQUIRE(!llvm::isa<llvm::AllocaInst>(inst));
+      REQUIRE(!llvm::isa<llvm::StoreInst>(inst));
+      inserts += llvm::isa<llvm::InsertValueInst>(inst);
+    }
+  }
+  REQUIRE(inserts == 2);
+}
+
+TEST_CASE("dead heap values are reused in place", "[llvmbackend]") {
+  const std::string program =
+      "nats(n) -> (n, nats(add(n, 1)))\n"
+      "cycle(xs, n) -> {\n"
+      "  is(n, 0) : (n, cycle(xs, 1));\n"
+      "  * : (n, cycle(nats(n), 0));\n"
+      "}\n"
+      "main() -> x | cycle(nats(0), 0); 0\n";
+
+  // `xs` dies on entering the wildcard case, where its cell is recycled to
+  // build the result if it was uniquely referenced.
+  llvm::LLVMContext context;
+  auto module = Compile(context, program);
+  auto cycle = module->getFunction("cycle_F2T2iri");
+  REQUIRE(CallsTo(*cycle, "darlang.reuse") == 1);
+  REQUIRE(CallsTo(*cycle, "darlang.drop") == 0);
+
+  // `x` is never read, and so is dropped as soon as it is bound.
+  REQUIRE(CallsTo(*module->getFunction("main"), "darlang.reuse") == 1);
+
+  LLVMBackendOptions options;
+  options.reference_counting = false;
+  auto uncounted_module = Compile(context, program, options);
+  REQUIRE(!uncounted_module->getFunction("darlang.reuse"));
+  REQUIRE(!uncounted_module->getFunction("darlang.drop"));
+}
+
+TEST_CASE("arguments that do not escape are borrowed", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "ignore(xs, n) -> n\n"
+      "nats(n) -> (n, nats(add(n, 1)))\n"
+      "main() -> x | nats(0); add(ignore(x, 1), ignore(x, 2))\n");
+
+  // The caller keeps ownership of `x`, releasing its references after each
+  // call returns.
+  REQUIRE(CallsTo(*module->getFunction("ignore_F2T2iri"), "darlang.") == 0);
+  REQUIRE(CallsTo(*module->getFunction("main"), "darlang.drop") == 2);
+
+  // Owned arguments to tail calls are passed along with their ownership, so
+  // that nothing is left to release after the call.
+  auto tail_module = Compile(context,
+      "ignore(xs, n) -> n\n"
+      "nats(n) -> (n, nats(add(n, 1)))\n"
+      "main() -> x | nats(0); ignore(x, 1)\n");
+  REQUIRE(CallsTo(*tail_module->getFunction("ignore_F2T2iri"), "darlang.") == 1);
+  REQUIRE(CallsTo(*tail_module->getFunction("main"), "darlang.") == 0);
+}
+
+TEST_CASE("guards wrap members of disjoint unions", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "either(a, b, c) -> {\n"
+      "  c : a;\n"
+      "  * : b;\n"
+      "}\n"
+      "main() -> x | either(1, \"one\", is(1, 1)); 0\n");
+
+  // Both cases join into a single return of the tagged union.
+  auto either = module->getFunction("either_F3isb");
+  REQUIRE(either->getReturnType()->isStructTy());
+  int returns = 0;
+  for (auto& block : *either) {
+    returns += llvm::isa<llvm::ReturnInst>(block.getTerminator());
+  }
+  REQUIRE(returns == 1);
+}
+
+TEST_CASE("recursive unions are built in heap cells", "[llvmbackend]") {
+  darlang_heap_reset();
+  auto program = Load(std::string(kRepeat) + "build() -> repeat(\"a\", 0, 3)\nmain() -> l | build(); 0\n",
+                      LLVMBackendOptions(), "build");
+  auto list = reinterpret_cast<const ConsCell*>(program.main());
+  REQUIRE(ListItems(list) == std::vector<std::string>({"a", "a", "a"}));
+  darlang_heap_reset();
+
+  // Lists passed to a function that ignores them are released by the caller,
+  // switching over the member each reference points to.
+  llvm::LLVMContext context;
+  const std::string dropped =
+      std::string(kRepeat) + "ignore(l, n) -> n\nmain() -> l | repeat(\"a\", 0, 3); ignore(l, 7)\n";
+  auto module = Compile(context, dropped);
+  int switches = 0;
+  for (auto& func : *module) {
+    for (auto& block : func) {
+      switches += func.getName().startswith("darlang.drop") && llvm::isa<llvm::SwitchInst>(block.getTerminator());
+    }
+  }
+  REQUIRE(switches == 1);
+  REQUIRE(Load(dropped).main() == 7);
+}
+
+TEST_CASE("lists allocate a single cons cell per element", "[llvmbackend]") {
+  // Lists have no cells of their own, so each element is a 16-byte cons cell
+  // on the host, allocated once.
+  llvm::LLVMContext context;
+  auto module = Compile(context, std::string(kRepeat) + "main() -> l | repeat(\"a\", 0, 3); 0\n");
+  auto repeat = module->getFunction("repeat_F3sii");
+  REQUIRE(repeat->getAttributes().getRetDereferenceableOrNullBytes() == sizeof(ConsCell));
+  REQUIRE(CallsTo(*repeat, "darlang_alloc") == 1);
+  REQUIRE(CallsTo(*module->getFunction("repeat_F3sii_dps"), "darlang_alloc") == 1);
+
+  // Building a list takes a single 32-byte block per element, bumped one
+  // after another from the head.
+  darlang_heap_reset();
+  auto program = Load(std::string(kRepeat) + "build() -> repeat(\"a\", 0, 100)\nmain() -> l | build(); 0\n",
+                      LLVMBackendOptions(), "build");
+  auto list = reinterpret_cast<const ConsCell*>(program.main());
+  REQUIRE(ListItems(list).size() == 100);
+  REQUIRE(darlang_heap.next - reinterpret_cast<const char*>(list) + sizeof(int64_t) == 100 * 32);
+  darlang_heap_reset();
+}
+
+// Returns the number of freed heap blocks of the given size awaiting reuse,
+// by allocating until the heap has to be bumped.
+static int Recycled(int64_t size) {
+  int recycled = 0;
+  for (;;) {
+    char* next = darlang_heap.next;
+    if (darlang_alloc(size) == next) {
+      return recycled;
+    }
+    recycled++;
+  }
+}
+
+TEST_CASE("dead lists are freed and reused at run time", "[llvmbackend]") {
+  // Each element of a list is a single cons cell, occupying a 32-byte block,
+  // i.e. a 16-byte struct behind its reference count.
+  const int64_t block_size = 32;
+  LLVMBackendOptions uncounted;
+  uncounted.reference_counting = false;
+
+  // `l` is never read, so each of its 100 cons cells is freed, three of which
+  // are recycled by the result as it is allocated.
+  const std::string dropped =
+      std::string(kRepeat) + "build() -> l | repeat(\"a\", 0, 100); repeat(\"b\", 0, 3)\n"
+      "main() -> l | build(); 0\n";
+  darlang_heap_reset();
+  {
+    auto program = Load(dropped, LLVMBackendOptions(), "build");
+    auto list = reinterpret_cast<const ConsCell*>(program.main());
+    REQUIRE(ListItems(list) == std::vector<std::string>({"b", "b", "b"}));
+    REQUIRE(Recycled(block_size) == 97);
+  }
+  darlang_heap_reset();
+  {
+    auto program = Load(dropped, uncounted, "build");
+    program.main();
+    REQUIRE(Recycled(block_size) == 0);
+  }
+  darlang_heap_reset();
+
+  // `l` dies before its cons cell can be recycled in place to build the
+  // result, releasing only the cells it references.
+  const std::string reused =
+      std::string(kRepeat) + "build() -> l | repeat(\"a\", 0, 1); {\n"
+      "  is(1, 1) : ();\n"
+      "         * : (\"b\", repeat(\"b\", 0, 1));\n"
+      "}\n"
+      "main() -> l | build(); 0\n";
+  {
+    auto program = Load(reused, LLVMBackendOptions(), "build");
+    auto list = reinterpret_cast<const ConsCell*>(program.main());
+    REQUIRE(ListItems(list).empty());
+    REQUIRE(Recycled(block_size) == 1);
+  }
+  darlang_heap_reset();
+  {
+    auto program = Load(reused, uncounted, "build");
+    program.main();
+    REQUIRE(Recycled(block_size) == 0);
+  }
+  darlang_heap_reset();
+}
+
+// Returns the number of stack slots allocated by a function.
+static int Allocas(llvm::Function& func) {
+  int allocas = 0;
+  for (auto& inst : func.getEntryBlock()) {
+    allocas += llvm::isa<llvm::AllocaInst>(inst);
+  }
+  return allocas;
+}
+
+TEST_CASE("unions that do not escape are built in the stack frame", "[llvmbackend]") {
+  const int64_t block_size = 32;
+  LLVMBackendOptions heap_only;
+  heap_only.stack_allocation = false;
+
+  // `l` is only ever read by the guard's own frame, so its cell lives in a
+  // stack slot. The cells it references are still freed through it, along
+  // with the three-item list passed to `count`.
+  const std::string local =
+      std::string(kTally) + "count(l, n) -> n\n"
+      "build() -> l | {\n"
+      "  is(1, 1) : (\"b\", tally(\"b\", 0, 3));\n"
+      "         * : 0;\n"
+      "}; add(count(l, 7), 0)\n"
+      "main() -> build()\n";
+  llvm::LLVMContext context;
+  auto module = Compile(context, local);
+  REQUIRE(Allocas(*module->getFunction("build_F0")) == 1);
+  REQUIRE(Allocas(*Compile(context, local, heap_only)->getFunction("build_F0")) == 0);
+  REQUIRE(Load(local).main() == 7);
+
+  const std::string freed =
+      std::string(kTally) + kRepeat + "build() -> l | {\n"
+      "  is(1, 1) : (\"b\", tally(\"b\", 0, 3));\n"
+      "         * : 0;\n"
+      "}; repeat(\"c\", 0, 1)\n"
+      "main() -> l | build(); 0\n";
+  darlang_heap_reset();
+  {
+    auto program = Load(freed, LLVMBackendOptions(), "build");
+    auto list = reinterpret_cast<const ConsCell*>(program.main());
+    REQUIRE(ListItems(list) == std::vector<std::string>({"c"}));
+    REQUIRE(Recycled(block_size) == 7);
+  }
+  darlang_heap_reset();
+  {
+    auto program = Load(freed, heap_only, "build");
+    auto list = reinterpret_cast<const ConsCell*>(program.main());
+    REQUIRE(ListItems(list) == std::vector<std::string>({"c"}));
+    REQUIRE(Recycled(block_size) == 8);
+  }
+  darlang_heap_reset();
+
+  // Unions returned from a guard, or bound and then returned, outlive the
+  // frame and stay on the heap.
+  const std::string returned =
+      std::string(kTally) + "build() -> l | {\n"
+      "  is(1, 2) : 0;\n"
+      "         * : (\"b\", tally(\"b\", 0, 2));\n"
+      "}; l\n"
+      "main() -> l | build(); 0\n";
+  REQUIRE(Allocas(*Compile(context, returned)->getFunction("tally_F3sii")) == 0);
+  REQUIRE(Allocas(*Compile(context, returned)->getFunction("build_F0")) == 0);
+  darlang_heap_reset();
+  {
+    auto program = Load(returned, LLVMBackendOptions(), "build");
+    auto list = reinterpret_cast<const TallyCell*>(program.main());
+    REQUIRE(TallyItems(list) == std::vector<std::string>({"b", "b", "b"}));
+  }
+  darlang_heap_reset();
+}
+
+TEST_CASE("lists are built with tail recursion modulo cons", "[llvmbackend]") {
+  // Each cons cell is wrapped into the list's union (i.e. referenced as the
+  // list) before its tail is filled in by the destination-passing variant.
+  llvm::LLVMContext context;
+  auto module = Compile(context, std::string(kRepeat) + "main() -> l | repeat(\"a\", 0, 3); 0\n");
+  auto repeat = module->getFunction("repeat_F3sii");
+  auto dps = module->getFunction("repeat_F3sii_dps");
+  REQUIRE(dps);
+  REQUIRE(Calls(*repeat).back()->getCalledFunction() == dps);
+  REQUIRE(Calls(*dps).back()->getCalledFunction() == dps);
+  REQUIRE(Calls(*dps).back()->isTailCall());
+
+  // A list far longer than the stack could hold frames for is built in
+  // constant stack space.
+  const int64_t length = 1000000;
+  darlang_heap_reset();
+  auto program = Load(std::string(kRepeat) + "build() -> repeat(\"a\", 0, 1000000)\nmain() -> l | build(); 0\n",
+                      LLVMBackendOptions(), "build");
+  auto list = reinterpret_cast<const ConsCell*>(program.main());
+  int64_t cells = 0;
+  for (; list; list = list->rest) {
+    cells++;
+  }
+  REQUIRE(cells == length);
+  darlang_heap_reset();
+}
+
+TEST_CASE("programs allocate from the thread's heap, released by main", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context, std::string(kRepeat) + "main() -> l | repeat(\"a\", 0, 3); 0\n");
+  REQUIRE(module->getGlobalVariable("darlang_heap")->isThreadLocal());
+  REQUIRE(CallsTo(*module->getFunction("main"), "darlang_heap_reset") == 1);
+
+  // The JIT runs on the thread that created it.
+  darlang_heap_reset();
+  auto program = Load(std::string(kRepeat) + "build() -> repeat(\"a\", 0, 3)\nmain() -> l | build(); 0\n",
+                      LLVMBackendOptions(), "build");
+  program.main();
+  REQUIRE(darlang_heap.chunks != nullptr);
+  darlang_heap_reset();
+}
+
+TEST_CASE("specializations are internal and carry inferred attributes", "[llvmbackend]") {
+  const std::string program =
+      "double(n) -> add(n, n)\n"
+      "nats(n) -> (n, nats(add(n, 1)))\n"
+      "main() -> x | nats(0); double(2)\n";
+
+  llvm::LLVMContext context;
+  auto module = Compile(context, program);
+  REQUIRE(module->getFunction("main")->hasExternalLinkage());
+
+  auto double_func = module->getFunction("double_F1i");
+  REQUIRE(double_func->hasInternalLinkage());
+  REQUIRE(double_func->doesNotThrow());
+  REQUIRE(double_func->doesNotAccessMemory());
+  REQUIRE(double_func->willReturn());
+
+  // Allocating cells touches memory, and recursion may never return.
+  auto nats = module->getFunction("nats_F1i");
+  REQUIRE(nats->doesNotThrow());
+  REQUIRE(!nats->doesNotAccessMemory());
+  REQUIRE(!nats->willReturn());
+  REQUIRE(nats->hasRetAttribute(llvm::Attribute::NonNull));
+  REQUIRE(nats->getAttributes().getRetDereferenceableBytes() > 0);
+
+  // Lists passed to a function point to their first cons cell, unless empty.
+  auto lists = Compile(context, std::string(kRepeat) + "count(l, n) -> n\nmain() -> count(repeat(\"a\", 0, 3), 0)\n");
+  auto count = lists->getFunction("count_F2D2T0T2sri");
+  REQUIRE(count);
+  REQUIRE(!count->hasParamAttribute(0, llvm::Attribute::NonNull));
+  REQUIRE(count->getParamDereferenceableOrNullBytes(0) > 0);
+
+  LLVMBackendOptions options;
+  options.internalize = false;
+  auto external_module = Compile(context, program, options);
+  REQUIRE(external_module->getFunction("double_F1i")->hasExternalLinkage());
+}
+
+TEST_CASE("wide tuples are passed and returned through memory", "[llvmbackend]") {
+  const std::string program =
+      "pair(n) -> (n, n)\n"
+      "wide(n) -> (n, n, n, n)\n"
+      "widen(n, t) -> {\n"
+      "  is(n, 0) : t;\n"
+      "  * : widen(mod(n, 2), wide(n));\n"
+      "}\n"
+      "main() -> p | pair(1); w | widen(3, wide(2)); 0\n";
+
+  llvm::LLVMContext context;
+  auto module = Compile(context, program);
+
+  // Tuples of two i64s still fit in registers.
+  REQUIRE(module->getFunction("pair_F1i")->getReturnType()->isStructTy());
+
+  auto wide = module->getFunction("wide_F1i");
+  REQUIRE(wide->getReturnType()->isVoidTy());
+  REQUIRE(wide->hasParamAttribute(0, llvm::Attribute::StructRet));
+
+  // Results of tail calls are written straight to the caller's slot.
+  auto widen = module->getFunction("widen_F2iT4iiii");
+  REQUIRE(widen->hasParamAttribute(0, llvm::Attribute::StructRet));
+  REQUIRE(widen->hasParamAttribute(2, llvm::Attribute::ByVal));
+  // Slots of by-value tuples are not heap cells.
+  REQUIRE(!widen->hasParamAttribute(0, llvm::Attribute::NonNull));
+  REQUIRE(!widen->hasParamAttribute(2, llvm::Attribute::NonNull));
+  REQUIRE(widen->getParamDereferenceableBytes(2) == 0);
+  for (auto call : Calls(*widen)) {
+    if (call->getCalledFunction() == widen) {
+      REQUIRE(call->isTailCall());
+      REQUIRE(call->getArgOperand(0) == widen->getArg(0));
+    }
+  }
+
+  LLVMBackendOptions options;
+  options.max_direct_aggregate_size = 32;
+  auto direct_module = Compile(context, program, options);
+  REQUIRE(direct_module->getFunction("wide_F1i")->getReturnType()->isStructTy());
+
+  // Items survive being copied into a call and stored to its caller's slot,
+  // with the flag moved behind the more strictly aligned items.
+  struct Wide {
+    int64_t n;
+    const char* str;
+    int64_t next;
+    bool flag;
+  };
+  const std::string round_trip =
+      "wide(s, n) -> (is(n, 5), n, s, add(n, 1))\n"
+      "pass(t) -> t\n"
+      "build() -> pass(wide(\"w\", 5))\n"
+      "main() -> t | build(); 0\n";
+  auto program_module = Compile(context, round_trip);
+  REQUIRE(program_module->getFunction("pass_F1T4bisi")->hasParamAttribute(1, llvm::Attribute::ByVal));
+  auto loaded = Load(round_trip, LLVMBackendOptions(), "build");
+  auto result = reinterpret_cast<const Wide*>(loaded.main());
+  REQUIRE(result->flag);
+  REQUIRE(result->n == 5);
+  REQUIRE(std::string(result->str) == "w");
+  REQUIRE(result->next == 6);
+}
+
+TEST_CASE("constants are evaluated into globals", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "double(n) -> add(n, n)\n"
+      "SIZE -> double(add(LIMIT, 1))\n"
+      "LIMIT -> 3\n"
+      "PAIR -> (SIZE, \"size\")\n"
+      "main() -> p | PAIR; add(SIZE, 1)\n");
+
+  auto size = module->getNamedGlobal("SIZE");
+  REQUIRE(size->isConstant());
+  REQUIRE(llvm::cast<llvm::ConstantInt>(size->getInitializer())->getSExtValue() == 8);
+  REQUIRE(module->getNamedGlobal("PAIR")->getValueType()->isStructTy());
+
+  // Scalars are used inline, rather than recomputed or loaded.
+  auto main = module->getFunction("main");
+  REQUIRE(CallsTo(*main, "double") == 0);
+  int loads = 0;
+  for (auto& block : *main) {
+    for (auto& inst : block) {
+      if (auto load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+        REQUIRE(load->getPointerOperand() == module->getNamedGlobal("PAIR"));
+        loads++;
+      }
+    }
+  }
+  REQUIRE(loads == 1);
+
+  // Initializers whose intrinsics would fold to poison fail to compile.
+  REQUIRE(CompileStatus("Z -> mod(7, 0)\nmain() -> Z\n") == 1);
+  REQUIRE(CompileStatus("Z -> mod(7, 2)\nmain() -> Z\n") == 0);
+}
+
+TEST_CASE("literals are shared across the module's constant pool", "[llvmbackend]") {
+  llvm::LLVMContext context;
+  auto module = Compile(context,
+      "name(n) -> \"name\"\n"
+      "wide(t) -> 0\n"
+      "WIDE -> (1, 2, 3, 4)\n"
+      "main() -> a | name(1); b | name(is(1, 1)); c | \"name\"; d | wide((1, 2, 3, 4)); wide(WIDE)\n");
+
+  // Every specialization refers to the same string.
+  int strings = 0;
+  for (auto& global : module->globals()) {
+    if (!global.hasInitializer()) {
+      continue;
+    }
+    if (auto data = llvm::dyn_cast<llvm::ConstantDataSequential>(global.getInitializer())) {
+      REQUIRE(data->getAsCString() == "name");
+      strings++;
+    }
+  }
+  REQUIRE(strings == 1);
+
+  // Wide constant arguments are passed straight from a global, rather than
+  // copied to the stack first.
+  auto main = module->getFunction("main");
+  for (auto call : Calls(*main)) {
+    if (call->getCalledFunction() == module->getFunction("wide_F1T4iiii")) {
+      REQUIRE(call->getArgOperand(0) == module->getNamedGlobal("WIDE"));
+    }
+  }
+  for (auto& block : *main) {
+    for (auto& inst : block) {
+      REQUIRE(!llvm::isa<llvm::AllocaInst>(&inst));
+    }
+  }
+}
+
+}  // namespace backend
+}  // namespace darlang
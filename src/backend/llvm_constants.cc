@@ -0,0 +1,217 @@
+#include "backend/llvm_constants.h"
+
+#include <cassert>
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+
+#include "backend/llvm_intrinsics.h"
+#include "backend/llvm_typer.h"
+
+namespace darlang::backend {
+
+namespace {
+
+// Bounds on the work done evaluating initializers. Calls are interpreted
+// recursively, so their depth is limited to keep clear of the stack's end.
+constexpr int kMaxCalls = 1 << 20;
+constexpr int kMaxDepth = 1000;
+
+}  // namespace
+
+// Evaluates an expression within a specialization, given the values of its
+// locals.
+class LLVMConstantEvaluator::Visitor : public ast::Visitor {
+ public:
+  Visitor(LLVMConstantEvaluator& evaluator, const typing::Specialization& spec, int num_locals, int depth)
+    : evaluator_(evaluator), context_(evaluator.pool_.context()), spec_(spec)
+    , locals_(num_locals), depth_(depth), value_(nullptr) {}
+
+  llvm::Constant* Evaluate(ast::Node& node) {
+    node.Visit(*this);
+    assert(value_);
+    return value_;
+  }
+
+  std::vector<llvm::Constant*>& locals() { return locals_; }
+
+  bool IdExpression(ast::IdExpressionNode& node) override {
+    assert(node.local >= 0 && static_cast<size_t>(node.local) < locals_.size());
+    value_ = locals_[node.local];
+    return false;
+  }
+
+  bool ConstantExpression(ast::ConstantExpressionNode& node) override {
+    value_ = evaluator_.Global(node.name)->getInitializer();
+    return false;
+  }
+
+  bool IntegralLiteral(ast::IntegralLiteralNode& node) override {
+    value_ = llvm::ConstantInt::get(llvm::Type::getInt64Ty(context_), node.literal);
+    return false;
+  }
+
+  bool StringLiteral(ast::StringLiteralNode& node) override {
+    value_ = evaluator_.pool_.String(node.literal);
+    return false;
+  }
+
+  bool BooleanLiteral(ast::BooleanLiteralNode& node) override {
+    value_ = llvm::ConstantInt::get(llvm::Type::getInt1Ty(context_), node.literal);
+    return false;
+  }
+
+  bool Invocation(ast::InvocationNode& node) override {
+    std::vector<llvm::Value*> args;
+    for (auto& arg : node.args) {
+      args.push_back(Evaluate(*arg));
+    }
+
+    // Intrinsics of constant arguments are folded by the builder, exactly as
+    // they would be when generating code for them. Operations undefined at
+    // runtime fold to poison, and others (e.g. comparing strings) to constant
+    // expressions, neither of which are values.
+    Intrinsic intrinsic = GetIntrinsic(node.callee);
+    if (intrinsic != Intrinsic::UNKNOWN) {
+      if (intrinsic == Intrinsic::MOD) {
+        auto divisor = llvm::dyn_cast<llvm::ConstantInt>(args[1]);
+        if (divisor && divisor->isZero()) {
+          Fail(node, "division by zero in initializer");
+        }
+      }
+      llvm::IRBuilder<> builder(context_);
+      value_ = llvm::cast<llvm::Constant>(GenerateIntrinsic(intrinsic, args, builder));
+      if (!llvm::isa<llvm::ConstantInt>(value_) && !llvm::isa<llvm::ConstantStruct>(value_)) {
+        Fail(node, "intrinsic cannot be evaluated at compile time");
+      }
+      return false;
+    }
+
+    if (++evaluator_.calls_ > kMaxCalls || depth_ >= kMaxDepth) {
+      Fail(node, "initializer is too expensive to evaluate at compile time");
+    }
+    auto callee_spec = spec_.callees.at(node.id);
+    auto& decl = static_cast<ast::DeclarationNode&>(*evaluator_.decls_.at(node.callee));
+    Visitor callee(evaluator_, *callee_spec, decl.num_locals, depth_ + 1);
+    for (size_t i = 0; i < args.size(); i++) {
+      callee.locals()[i] = llvm::cast<llvm::Constant>(args[i]);
+    }
+    value_ = callee.Evaluate(*decl.expr);
+    return false;
+  }
+
+  bool Guard(ast::GuardNode& node) override {
+    if (dynamic_cast<typing::DisjointUnion*>(&TypeOf(node))) {
+      Fail(node, "disjoint unions cannot be evaluated at compile time");
+    }
+    for (auto& guard_case : node.cases) {
+      auto cond = llvm::dyn_cast<llvm::ConstantInt>(Evaluate(*guard_case.first));
+      if (!cond) {
+        Fail(*guard_case.first, "guard condition is not constant");
+      }
+      if (cond->isOne()) {
+        value_ = Evaluate(*guard_case.second);
+        return false;
+      }
+    }
+    value_ = Evaluate(*node.wildcard_case);
+    return false;
+  }
+
+  bool Bind(ast::BindNode& node) override {
+    assert(node.local >= 0 && static_cast<size_t>(node.local) < locals_.size());
+    locals_[node.local] = Evaluate(*node.expr);
+    value_ = Evaluate(*node.body);
+    return false;
+  }
+
+  bool Tuple(ast::TupleNode& node) override {
+    auto tuple_type = llvm::dyn_cast<llvm::StructType>(
+        LLVMTypeGenerator::Generate(context_, TypeOf(node), evaluator_.cache_));
+    if (!tuple_type) {
+      Fail(node, "recursive tuples cannot be evaluated at compile time");
+    }
+    std::vector<llvm::Constant*> fields(node.items.size());
+    for (unsigned int i = 0; i < node.items.size(); i++) {
+      fields[evaluator_.cache_.FieldIndex(tuple_type, i)] = Evaluate(*std::get<ast::NodePtr>(node.items[i]));
+    }
+    value_ = llvm::ConstantStruct::get(tuple_type, fields);
+    return false;
+  }
+
+ private:
+  typing::Type& TypeOf(const ast::Node& node) const {
+    return evaluator_.specs_.registry().Get(spec_.types.at(node.id));
+  }
+
+  void Fail(const ast::Node& node, const std::string& message) {
+    evaluator_.log_.Fatal(Result::Error(ErrorCode::EVAL_FAILED, message), node.start);
+  }
+
+  LLVMConstantEvaluator& evaluator_;
+  llvm::LLVMContext& context_;
+  // The specialization of the function (or constant) being evaluated.
+  const typing::Specialization& spec_;
+  std::vector<llvm::Constant*> locals_;
+  // The number of calls being evaluated beneath the initializer.
+  int depth_;
+  llvm::Constant* value_;
+};
+
+llvm::Constant* LLVMConstantPool::String(const std::string& literal) {
+  auto it = strings_.find(literal);
+  if (it != strings_.end()) {
+    return it->second;
+  }
+  // LLVM null-terminates the data, which we may want to reconsider later.
+  llvm::IRBuilder<> builder(context());
+  auto ptr = llvm::cast<llvm::Constant>(builder.CreateGlobalStringPtr(literal, "", 0, module_));
+  strings_[literal] = ptr;
+  return ptr;
+}
+
+llvm::GlobalVariable* LLVMConstantPool::Global(llvm::Constant* value) {
+  auto it = globals_.find(value);
+  if (it != globals_.end()) {
+    return it->second;
+  }
+  auto global = new llvm::GlobalVariable(*module_, value->getType(), true, llvm::GlobalValue::PrivateLinkage,
+                                         value);
+  global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  globals_[value] = global;
+  return global;
+}
+
+llvm::GlobalVariable* LLVMConstantPool::Define(const std::string& name, llvm::Constant* value) {
+  assert(!named_.count(name));
+  auto global = new llvm::GlobalVariable(*module_, value->getType(), true, llvm::GlobalValue::PrivateLinkage,
+                                         value, name);
+  global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  named_[name] = global;
+  // Literals of the same value may share the constant's global.
+  globals_.insert({value, global});
+  return global;
+}
+
+llvm::GlobalVariable* LLVMConstantEvaluator::Global(const std::string& name) {
+  if (auto global = pool_.Lookup(name)) {
+    return global;
+  }
+
+  auto& node = static_cast<ast::ConstantNode&>(*decls_.at(name));
+  if (!evaluating_.insert(name).second) {
+    log_.Fatal(Result::Error(ErrorCode::EVAL_FAILED, "constant " + name + " depends on its own value"), node.start);
+  }
+  llvm::Constant* value = Evaluate(node);
+  evaluating_.erase(name);
+  return pool_.Define(name, value);
+}
+
+llvm::Constant* LLVMConstantEvaluator::Evaluate(ast::ConstantNode& node) {
+  // Constants are specialized exactly once, as functions of no arguments.
+  const auto& specs = specs_.Get(node.name);
+  assert(specs.size() == 1);
+  Visitor visitor(*this, specs.front(), node.num_locals, 0);
+  return visitor.Evaluate(*node.expr);
+}
+
+}  // namespace darlang::backend
@@ -0,0 +1,88 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_CONSTANTS_H_
+#define DARLANG_SRC_BACKEND_LLVM_CONSTANTS_H_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+
+#include "ast/types.h"
+#include "logger.h"
+#include "typing/function_specializer.h"
+#include "util/declaration_mapper.h"
+
+namespace darlang::backend {
+
+class LLVMTypeCache;
+
+// Literal data shared by every function in a module. Each distinct string or
+// aggregate is emitted as a single constant global, alongside the globals
+// holding the module's named constants.
+class LLVMConstantPool {
+ public:
+  explicit LLVMConstantPool(llvm::Module* module) : module_(module) {}
+
+  llvm::LLVMContext& context() const { return module_->getContext(); }
+
+  // Returns a pointer to the null-terminated characters of a string literal.
+  llvm::Constant* String(const std::string& literal);
+  // Returns a global holding the given value.
+  llvm::GlobalVariable* Global(llvm::Constant* value);
+
+  // Emits the global holding the value of a named constant.
+  llvm::GlobalVariable* Define(const std::string& name, llvm::Constant* value);
+  // Returns the global holding a named constant, or nullptr if it has yet to
+  // be defined.
+  llvm::GlobalVariable* Lookup(const std::string& name) const {
+    auto it = named_.find(name);
+    return it != named_.end() ? it->second : nullptr;
+  }
+
+ private:
+  llvm::Module* module_;
+  std::unordered_map<std::string, llvm::Constant*> strings_;
+  // Constants are uniqued by their context, so can be keyed by identity.
+  std::unordered_map<llvm::Constant*, llvm::GlobalVariable*> globals_;
+  std::unordered_map<std::string, llvm::GlobalVariable*> named_;
+};
+
+// Evaluates the initializers of constant declarations at compile time,
+// defining their values in the module's constant pool.
+//
+// Initializers are interpreted over the solved types of their specialization,
+// and may bind locals, branch, call intrinsics (folded exactly as they would
+// be at runtime) and call other functions in the module. Evaluation fails if
+// an initializer builds a value that has no constant representation, i.e. a
+// recursive tuple or a disjoint union, divides by zero or otherwise folds an
+// intrinsic to anything but a value, or exceeds a fixed budget of calls.
+class LLVMConstantEvaluator {
+ public:
+  LLVMConstantEvaluator(LLVMConstantPool& pool, typing::SpecializationMap& specs,
+                        const util::DeclarationMap& decls, LLVMTypeCache& cache, Logger& log)
+    : pool_(pool), specs_(specs), decls_(decls), cache_(cache), log_(log), calls_(0) {}
+
+  // Returns the global holding the value of a constant, evaluating its
+  // initializer on first use.
+  llvm::GlobalVariable* Global(const std::string& name);
+
+ private:
+  class Visitor;
+
+  // Evaluates the initializer of a constant declaration. Failures are fatal.
+  llvm::Constant* Evaluate(ast::ConstantNode& node);
+
+  LLVMConstantPool& pool_;
+  typing::SpecializationMap& specs_;
+  const util::DeclarationMap& decls_;
+  LLVMTypeCache& cache_;
+  Logger& log_;
+  // Constants whose initializers are being evaluated, to detect cycles.
+  std::unordered_set<std::string> evaluating_;
+  // The number of calls evaluated so far, across all initializers.
+  int calls_;
+};
+
+}  // namespace darlang::backend
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_CONSTANTS_H_
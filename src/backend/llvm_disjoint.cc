@@ -0,0 +1,112 @@
+#include "backend/llvm_disjoint.h"
+
+namespace darlang {
+namespace backend {
+
+/* static */
+llvm::Value* LLVMDisjoint::CreateInject(llvm::IRBuilder<>& builder, llvm::Type* type,
+                                        const LLVMDisjointLayout& layout, unsigned int tag, llvm::Value* value) {
+  assert(tag < layout.members.size());
+  assert(value->getType() == layout.members[tag]);
+  auto ptr_type = builder.getInt8PtrTy();
+
+  switch (layout.kind) {
+    case LLVMDisjointLayout::NULLABLE:
+      if (!value->getType()->isPointerTy()) {
+        return llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(type));
+      }
+      return builder.CreateBitCast(value, type);
+    case LLVMDisjointLayout::POINTER_TAGGED: {
+      // Offsetting the pointer (rather than masking an integer) keeps it
+      // visible to alias analysis.
+      auto ptr = builder.CreateBitCast(value, ptr_type);
+      if (tag) {
+        ptr = builder.CreateGEP(builder.getInt8Ty(), ptr, builder.getInt64(tag));
+      }
+      return builder.CreateBitCast(ptr, type);
+    }
+    case LLVMDisjointLayout::TAGGED: {
+      auto struct_type = llvm::cast<llvm::StructType>(type);
+      auto slot = CreateSlot(builder, struct_type);
+      CreateStore(builder, struct_type, layout, tag, value, slot);
+      return builder.CreateLoad(struct_type, slot);
+    }
+  }
+  assert(false);
+  return nullptr;
+}
+
+/* static */
+void LLVMDisjoint::CreateStore(llvm::IRBuilder<>& builder, llvm::StructType* type,
+                               const LLVMDisjointLayout& layout, unsigned int tag, llvm::Value* value,
+                               llvm::Value* addr) {
+  assert(layout.kind == LLVMDisjointLayout::TAGGED);
+  assert(tag < layout.members.size());
+  auto tag_type = type->getElementType(0);
+  builder.CreateStore(llvm::ConstantInt::get(tag_type, tag), builder.CreateStructGEP(type, addr, 0));
+  auto data_addr = builder.CreateStructGEP(type, addr, 1);
+  builder.CreateStore(value, builder.CreateBitCast(data_addr, value->getType()->getPointerTo()));
+}
+
+/* static */
+llvm::Value* LLVMDisjoint::CreateLoadTag(llvm::IRBuilder<>& builder, llvm::StructType* type, llvm::Value* addr) {
+  return builder.CreateLoad(type->getElementType(0), builder.CreateStructGEP(type, addr, 0));
+}
+
+/* static */
+llvm::Value* LLVMDisjoint::CreateLoadMember(llvm::IRBuilder<>& builder, llvm::StructType* type,
+                                            const LLVMDisjointLayout& layout, unsigned int tag,
+                                            llvm::Value* addr) {
+  assert(layout.kind == LLVMDisjointLayout::TAGGED);
+  assert(tag < layout.members.size());
+  llvm::Type* member_type = layout.members[tag];
+  auto data_addr = builder.CreateStructGEP(type, addr, 1);
+  return builder.CreateLoad(member_type, builder.CreateBitCast(data_addr, member_type->getPointerTo()));
+}
+
+/* static */
+llvm::Value* LLVMDisjoint::CreateExtractTag(llvm::IRBuilder<>& builder, const LLVMDisjointLayout& layout,
+                                            llvm::Value* value) {
+  switch (layout.kind) {
+    case LLVMDisjointLayout::NULLABLE: {
+      unsigned int ptr_tag = layout.members[1]->isPointerTy();
+      return builder.CreateSelect(builder.CreateIsNull(value), builder.getInt64(1 - ptr_tag),
+                                  builder.getInt64(ptr_tag));
+    }
+    case LLVMDisjointLayout::POINTER_TAGGED: {
+      uint64_t mask = llvm::PowerOf2Ceil(layout.members.size()) - 1;
+      return builder.CreateAnd(builder.CreatePtrToInt(value, builder.getInt64Ty()), mask);
+    }
+    case LLVMDisjointLayout::TAGGED:
+      break;
+  }
+  assert(false);
+  return nullptr;
+}
+
+/* static */
+llvm::Value* LLVMDisjoint::CreateExtractMember(llvm::IRBuilder<>& builder, const LLVMDisjointLayout& layout,
+                                               unsigned int tag, llvm::Value* value) {
+  assert(layout.kind != LLVMDisjointLayout::TAGGED);
+  assert(tag < layout.members.size());
+  llvm::Type* member_type = layout.members[tag];
+  if (!member_type->isPointerTy()) {
+    return llvm::Constant::getNullValue(member_type);
+  }
+  // Undo the offset applied by CreateInject.
+  auto ptr = builder.CreateBitCast(value, builder.getInt8PtrTy());
+  if (layout.kind == LLVMDisjointLayout::POINTER_TAGGED && tag) {
+    ptr = builder.CreateGEP(builder.getInt8Ty(), ptr, builder.getInt64(-static_cast<int64_t>(tag)));
+  }
+  return builder.CreateBitCast(ptr, member_type);
+}
+
+/* static */
+llvm::Value* LLVMDisjoint::CreateSlot(llvm::IRBuilder<>& builder, llvm::Type* type) {
+  auto& entry_block = builder.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> entry_builder(&entry_block, entry_block.begin());
+  return entry_builder.CreateAlloca(type);
+}
+
+}  // namespace backend
+}  // namespace darlang
@@ -0,0 +1,58 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_DISJOINT_H_
+#define DARLANG_SRC_BACKEND_LLVM_DISJOINT_H_
+
+#include "llvm/IR/IRBuilder.h"
+
+#include "backend/llvm_typer.h"
+
+namespace darlang {
+namespace backend {
+
+// Emits instructions constructing and inspecting disjoint union values,
+// according to the layout chosen for them by LLVMTypeGenerator.
+//
+// Recursive TAGGED unions live in heap cells referenced by pointer, which are
+// inspected in place. Other recursive unions are referenced by a (tagged)
+// pointer to their member's cell, and inspected through it.
+class LLVMDisjoint {
+ public:
+  // Wraps a value of the member with the given tag into a union of type
+  // `type`, which must not be a recursive TAGGED union.
+  static llvm::Value* CreateInject(llvm::IRBuilder<>& builder, llvm::Type* type,
+                                   const LLVMDisjointLayout& layout, unsigned int tag, llvm::Value* value);
+
+  // Stores the tag and value of a member into a TAGGED union of struct type
+  // `type` at `addr`.
+  static void CreateStore(llvm::IRBuilder<>& builder, llvm::StructType* type,
+                          const LLVMDisjointLayout& layout, unsigned int tag, llvm::Value* value,
+                          llvm::Value* addr);
+
+  // Loads the tag of the member held by a TAGGED union at `addr`, as an
+  // integer of the union's tag type.
+  static llvm::Value* CreateLoadTag(llvm::IRBuilder<>& builder, llvm::StructType* type, llvm::Value* addr);
+
+  // Loads the member with the given tag from a TAGGED union at `addr`. The
+  // result is undefined if the union holds a different member.
+  static llvm::Value* CreateLoadMember(llvm::IRBuilder<>& builder, llvm::StructType* type,
+                                       const LLVMDisjointLayout& layout, unsigned int tag, llvm::Value* addr);
+
+  // Returns the tag of the member held by a NULLABLE or POINTER_TAGGED union,
+  // as an i64.
+  static llvm::Value* CreateExtractTag(llvm::IRBuilder<>& builder, const LLVMDisjointLayout& layout,
+                                       llvm::Value* value);
+
+  // Returns the member with the given tag from a NULLABLE or POINTER_TAGGED
+  // union. The result is undefined if the union holds a different member.
+  static llvm::Value* CreateExtractMember(llvm::IRBuilder<>& builder, const LLVMDisjointLayout& layout,
+                                          unsigned int tag, llvm::Value* value);
+
+ private:
+  // Returns a slot in the current function's entry block to spill a tagged
+  // union through while converting its data.
+  static llvm::Value* CreateSlot(llvm::IRBuilder<>& builder, llvm::Type* type);
+};
+
+}  // namespace backend
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_DISJOINT_H_
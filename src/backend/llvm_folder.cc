@@ -0,0 +1,187 @@
+#include "backend/llvm_folder.h"
+
+#include <map>
+#include <sstream>
+#include "llvm/IR/DerivedTypes.h"
+
+#include "backend/llvm_typer.h"
+#include "intrinsics.h"
+
+namespace darlang {
+namespace backend {
+
+namespace {
+
+// Collects all calls to non-intrinsic functions within an expression.
+class CallCollector : public ast::Visitor {
+ public:
+  CallCollector(std::vector<ast::InvocationNode*>& calls) : calls_(calls) {}
+
+  bool Invocation(ast::InvocationNode& node) override {
+    if (GetIntrinsic(node.callee) == Intrinsic::UNKNOWN) {
+      calls_.push_back(&node);
+    }
+    return true;
+  }
+
+  bool Guard(ast::GuardNode& node) override {
+    return true;
+  }
+
+  bool Bind(ast::BindNode& node) override {
+    node.expr->Visit(*this);
+    node.body->Visit(*this);
+    return false;
+  }
+
+  bool Tuple(ast::TupleNode& node) override {
+    for (auto& item : node.items) {
+      std::get<ast::NodePtr>(item)->Visit(*this);
+    }
+    return false;
+  }
+
+ private:
+  std::vector<ast::InvocationNode*>& calls_;
+};
+
+// Recursively describes the layout of a type, replacing revisited structs
+// with a back-reference to their depth on the current path. Pointers are
+// followed only to heap cells, as anything else they reference (i.e.
+// strings) shares a layout. Tagged references to recursive unions are
+// followed to each of their members.
+void AppendLayoutKey(llvm::Type* type, const LLVMTypeCache& cache, std::vector<llvm::Type*>& path,
+                     std::stringstream& ss) {
+  if (auto int_type = llvm::dyn_cast<llvm::IntegerType>(type)) {
+    ss << "i" << int_type->getBitWidth();
+  } else if (auto layout = cache.LookupTaggedRef(type)) {
+    ss << (layout->kind == LLVMDisjointLayout::NULLABLE ? "?" : "|") << "(";
+    for (auto member : layout->members) {
+      AppendLayoutKey(member, cache, path, ss);
+      ss << ",";
+    }
+    ss << ")";
+  } else if (type->isPointerTy()) {
+    ss << "*";
+    if (auto cell_type = cache.HeapCell(type)) {
+      AppendLayoutKey(cell_type, cache, path, ss);
+    }
+  } else if (auto struct_type = llvm::dyn_cast<llvm::StructType>(type)) {
+    for (size_t i = 0; i < path.size(); i++) {
+      if (path[i] == type) {
+        ss << "^" << i;
+        return;
+      }
+    }
+    path.push_back(type);
+    ss << (struct_type->isPacked() ? "<{" : "{");
+    for (auto element : struct_type->elements()) {
+      AppendLayoutKey(element, cache, path, ss);
+      ss << ",";
+    }
+    ss << (struct_type->isPacked() ? "}>" : "}");
+    path.pop_back();
+  } else if (auto array_type = llvm::dyn_cast<llvm::ArrayType>(type)) {
+    ss << "[" << array_type->getNumElements() << "x";
+    AppendLayoutKey(array_type->getElementType(), cache, path, ss);
+    ss << "]";
+  } else if (auto func_type = llvm::dyn_cast<llvm::FunctionType>(type)) {
+    ss << "(";
+    for (auto param : func_type->params()) {
+      AppendLayoutKey(param, cache, path, ss);
+      ss << ",";
+    }
+    ss << ")";
+    AppendLayoutKey(func_type->getReturnType(), cache, path, ss);
+  } else if (type->isFloatTy()) {
+    ss << "f32";
+  } else {
+    // Fall back to type identity for anything we don't lower to.
+    ss << "?" << type;
+  }
+}
+
+}  // namespace
+
+/* static */
+FoldMap LLVMSpecializationFolder::Fold(llvm::LLVMContext& context,
+                                       typing::SpecializationMap& specs,
+                                       LLVMTypeCache& cache,
+                                       ast::ModuleNode& module) {
+  LLVMSpecializationFolder folder(context, specs, cache);
+
+  std::vector<ast::DeclarationNode*> decls;
+  for (auto& child : module.body) {
+    if (auto decl = dynamic_cast<ast::DeclarationNode*>(child.get())) {
+      decls.push_back(decl);
+      CallCollector collector(folder.calls_[decl]);
+      decl->expr->Visit(collector);
+    }
+  }
+
+  while (folder.FoldOnce(decls)) {}
+  return std::move(folder.folds_);
+}
+
+/* static */
+std::string LLVMSpecializationFolder::LayoutKey(llvm::Type* type, const LLVMTypeCache& cache) {
+  std::vector<llvm::Type*> path;
+  std::stringstream ss;
+  AppendLayoutKey(type, cache, path, ss);
+  return ss.str();
+}
+
+bool LLVMSpecializationFolder::FoldOnce(const std::vector<ast::DeclarationNode*>& decls) {
+  FoldMap folds;
+
+  for (auto decl : decls) {
+    // The first specialization bearing each signature implements the rest.
+    std::unordered_map<std::string, const typing::Specialization*> implementations;
+    for (auto& spec : specs_.Get(decl->name)) {
+      auto inserted = implementations.insert({Signature(*decl, spec), &spec});
+      if (!inserted.second) {
+        folds[&spec] = inserted.first->second;
+      }
+    }
+  }
+
+  bool changed = folds != folds_;
+  folds_ = std::move(folds);
+  return changed;
+}
+
+std::string LLVMSpecializationFolder::Signature(const ast::DeclarationNode& decl,
+                                                const typing::Specialization& spec) {
+  const auto& registry = specs_.registry();
+  std::stringstream ss;
+  ss << LayoutKey(LLVMTypeGenerator::Generate(context_, registry.Get(spec.func_type), cache_), cache_);
+
+  // Specializations of a declaration share an AST, so comparing the lowered
+  // type of each node in order suffices to compare generated code.
+  std::map<ast::NodeID, typing::TypeID> ordered_types(spec.types.begin(), spec.types.end());
+  for (auto& node_type : ordered_types) {
+    ss << ";" << node_type.first << ":"
+       << LayoutKey(LLVMTypeGenerator::Generate(context_, registry.Get(node_type.second), cache_), cache_);
+  }
+
+  for (auto call : calls_[&decl]) {
+    auto callee = Callee(*call, spec);
+    // Self-recursive calls are identical in code, regardless of specialization.
+    if (callee == &spec) {
+      ss << ";self";
+    } else {
+      ss << ";" << static_cast<const void*>(callee);
+    }
+  }
+  return ss.str();
+}
+
+const typing::Specialization* LLVMSpecializationFolder::Callee(const ast::InvocationNode& node,
+                                                               const typing::Specialization& spec) const {
+  auto callee = spec.callees.at(node.id);
+  auto it = folds_.find(callee);
+  return it != folds_.end() ? it->second : callee;
+}
+
+}  // namespace backend
+}  // namespace darlang
@@ -0,0 +1,72 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_FOLDER_H_
+#define DARLANG_SRC_BACKEND_LLVM_FOLDER_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Type.h"
+
+#include "ast/types.h"
+#include "typing/function_specializer.h"
+
+namespace darlang {
+namespace backend {
+
+class LLVMTypeCache;
+
+// Maps each folded specialization to the specialization whose generated
+// function implements it.
+typedef std::unordered_map<const typing::Specialization*, const typing::Specialization*> FoldMap;
+
+// Detects specializations of a declaration that lower to identical code, such
+// that a single function body can be emitted for all of them. Two
+// specializations fold if their signatures and every node within them lower
+// to LLVM types of identical layout, and all of their calls resolve to the
+// same (folded) functions.
+//
+// Folding happens to a fixed point, as specializations may only become
+// identical once their callees have been folded.
+class LLVMSpecializationFolder {
+ public:
+  static FoldMap Fold(llvm::LLVMContext& context,
+                      typing::SpecializationMap& specs,
+                      LLVMTypeCache& cache,
+                      ast::ModuleNode& module);
+
+  // Returns a string describing the machine-level layout of an LLVM type,
+  // whose heap cells are described by the given cache. Types with equal
+  // layout keys are interchangeable in generated code.
+  static std::string LayoutKey(llvm::Type* type, const LLVMTypeCache& cache);
+
+ private:
+  LLVMSpecializationFolder(llvm::LLVMContext& context,
+                           typing::SpecializationMap& specs,
+                           LLVMTypeCache& cache)
+    : context_(context), specs_(specs), cache_(cache) {}
+
+  // Folds the specializations of all declarations once, using the callee
+  // folds from the previous iteration. Returns true if any fold changed.
+  bool FoldOnce(const std::vector<ast::DeclarationNode*>& decls);
+
+  // Computes a key identifying the code generated for a specialization.
+  std::string Signature(const ast::DeclarationNode& decl,
+                        const typing::Specialization& spec);
+
+  // Returns the specialization implementing a call from a specialization.
+  const typing::Specialization* Callee(const ast::InvocationNode& node,
+                                       const typing::Specialization& spec) const;
+
+  llvm::LLVMContext& context_;
+  typing::SpecializationMap& specs_;
+  LLVMTypeCache& cache_;
+
+  // Non-intrinsic invocations within each declaration, in traversal order.
+  std::unordered_map<const ast::DeclarationNode*, std::vector<ast::InvocationNode*>> calls_;
+  FoldMap folds_;
+};
+
+}  // namespace backend
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_FOLDER_H_
@@ -0,0 +1,67 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
+
+#include "backend/llvm_backend.h"
+#include "backend/llvm_folder.h"
+#include "backend/llvm_typer.h"
+#include "parsing/lexer.h"
+#include "parsing/parser.h"
+#include "scoping/scope_transform.h"
+#include "typing/module_specializer.h"
+
+namespace darlang {
+namespace backend {
+
+TEST_CASE("recursive structs of identical shape share a layout", "[llvmfolder]") {
+  llvm::LLVMContext context;
+  llvm::DataLayout layout("");
+  LLVMTypeCache cache(layout);
+  auto int_type = llvm::Type::getInt64Ty(context);
+
+  auto a = llvm::StructType::create(context);
+  a->setBody({int_type, cache.InsertHeapCell(a)});
+  auto b = llvm::StructType::create(context);
+  b->setBody({int_type, cache.InsertHeapCell(b)});
+  auto c = llvm::StructType::create(context);
+  c->setBody({int_type, a->getPointerTo()});
+
+  REQUIRE(LLVMSpecializationFolder::LayoutKey(a, cache) == LLVMSpecializationFolder::LayoutKey(b, cache));
+  REQUIRE(LLVMSpecializationFolder::LayoutKey(a, cache) != LLVMSpecializationFolder::LayoutKey(c, cache));
+}
+
+TEST_CASE("specializations differing only in tags share a function", "[llvmfolder]") {
+  std::stringstream source(
+      "first(t) -> t\n"
+      "main() ->\n"
+      "  a | first((~x 1));\n"
+      "  b | first((~y 2));\n"
+      "  0\n");
+
+  Logger log(std::cerr);
+  parsing::Lexer lexer(log, source, "test");
+  parsing::TokenStream tokens(lexer);
+  parsing::Parser parser(log, tokens);
+  auto module = parser.ParseModule();
+  scoping::ScopeTransform::Resolve(log, *module);
+
+  typing::ModuleSpecializer specializer(log, true);
+  auto& specs = specializer.Specialize(*module);
+
+  llvm::LLVMContext context;
+  auto llvm_module = LLVMModuleTransformer::Transform(context, specs, *module);
+
+  int first_funcs = 0;
+  for (auto& func : *llvm_module) {
+    if (func.getName().startswith("first")) {
+      first_funcs++;
+      REQUIRE(func.size() == 1);
+    }
+  }
+  REQUIRE(first_funcs == 1);
+}
+
+}  // namespace backend
+}  // namespace darlang
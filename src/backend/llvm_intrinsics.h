@@ -7,7 +7,8 @@
 namespace darlang {
 namespace backend {
 
-llvm::Value* GenerateIntrinsic(Intrinsic intrinsic, std::vector<llvm::Value*> args, llvm::IRBuilder<> builder) {
+inline llvm::Value* GenerateIntrinsic(Intrinsic intrinsic, const std::vector<llvm::Value*>& args,
+                                      llvm::IRBuilderBase& builder) {
   switch (intrinsic) {
     case Intrinsic::IS:
       // TODO: type this for integers + floats
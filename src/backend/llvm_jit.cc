@@ -0,0 +1,88 @@
+#include "backend/llvm_jit.h"
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include "runtime/runtime.h"
+
+namespace darlang::backend {
+
+/* static */
+Failable<std::unique_ptr<LLVMJit>> LLVMJit::Create(OptLevel level) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto machine_builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!machine_builder) {
+    return Result::Error(ErrorCode::TARGET_UNSUPPORTED, llvm::toString(machine_builder.takeError()));
+  }
+  machine_builder->setCodeGenOptLevel(LLVMOptimizer::CodeGenLevel(level));
+
+  auto jit = llvm::orc::LLJITBuilder()
+      .setJITTargetMachineBuilder(std::move(*machine_builder))
+      .create();
+  if (!jit) {
+    return Result::Error(ErrorCode::TARGET_UNSUPPORTED, llvm::toString(jit.takeError()));
+  }
+
+  std::unique_ptr<LLVMJit> darlang_jit(new LLVMJit(std::move(*jit)));
+  Result result = darlang_jit->DefineRuntime();
+  if (!result) {
+    return result;
+  }
+  return std::move(darlang_jit);
+}
+
+Result LLVMJit::DefineRuntime() {
+  auto& dylib = jit_->getMainJITDylib();
+
+  // Bind the runtime directly, as the host need not export its symbols.
+  llvm::orc::MangleAndInterner mangle(jit_->getExecutionSession(), jit_->getDataLayout());
+  llvm::orc::SymbolMap runtime_symbols;
+  runtime_symbols[mangle("darlang_alloc")] = llvm::JITEvaluatedSymbol(
+      llvm::pointerToJITTargetAddress(&darlang_alloc), llvm::JITSymbolFlags::Exported);
+  runtime_symbols[mangle("darlang_free")] = llvm::JITEvaluatedSymbol(
+      llvm::pointerToJITTargetAddress(&darlang_free), llvm::JITSymbolFlags::Exported);
+  runtime_symbols[mangle("darlang_heap_reset")] = llvm::JITEvaluatedSymbol(
+      llvm::pointerToJITTargetAddress(&darlang_heap_reset), llvm::JITSymbolFlags::Exported);
+  runtime_symbols[mangle("darlang_heap")] = llvm::JITEvaluatedSymbol(
+      llvm::pointerToJITTargetAddress(&darlang_heap), llvm::JITSymbolFlags::Exported);
+  if (auto err = dylib.define(llvm::orc::absoluteSymbols(std::move(runtime_symbols)))) {
+    return Result::Error(ErrorCode::CODEGEN_FAILED, llvm::toString(std::move(err)));
+  }
+
+  // Fall back to the host process's libraries for everything else.
+  auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      jit_->getDataLayout().getGlobalPrefix());
+  if (!generator) {
+    return Result::Error(ErrorCode::CODEGEN_FAILED, llvm::toString(generator.takeError()));
+  }
+  dylib.addGenerator(std::move(*generator));
+  return Result::Ok();
+}
+
+Result LLVMJit::AddModule(std::unique_ptr<llvm::Module> module,
+                          std::unique_ptr<llvm::LLVMContext> context) {
+  assert(module->getDataLayout() == jit_->getDataLayout());
+  // The heap is bound to the creating thread's instance, by address, rather
+  // than resolved through thread-local storage.
+  if (auto heap = module->getGlobalVariable("darlang_heap")) {
+    heap->setThreadLocal(false);
+  }
+  llvm::orc::ThreadSafeModule ts_module(std::move(module), std::move(context));
+  if (auto err = jit_->addIRModule(std::move(ts_module))) {
+    return Result::Error(ErrorCode::CODEGEN_FAILED, llvm::toString(std::move(err)));
+  }
+  return Result::Ok();
+}
+
+Failable<int64_t (*)()> LLVMJit::LookupMain() {
+  auto symbol = jit_->lookup("main");
+  if (!symbol) {
+    return Result::Error(ErrorCode::CODEGEN_FAILED, llvm::toString(symbol.takeError()));
+  }
+  return reinterpret_cast<int64_t (*)()>(symbol->getAddress());
+}
+
+}  // namespace darlang::backend
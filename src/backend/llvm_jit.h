@@ -0,0 +1,49 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_JIT_H_
+#define DARLANG_SRC_BACKEND_LLVM_JIT_H_
+
+#include <cstdint>
+#include <memory>
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include "backend/llvm_optimizer.h"
+#include "errors.h"
+
+namespace darlang::backend {
+
+// Compiles and executes darlang modules in-process, using ORC's LLJIT.
+//
+// Calls from generated code into the darlang runtime are bound to the copy
+// linked into the host process, and other external symbols (e.g. libc) are
+// resolved from the host's loaded libraries. Generated code allocates from the
+// heap of the thread that created the JIT, and so must only run on it.
+class LLVMJit {
+ public:
+  // Creates a JIT targeting the host machine.
+  static Failable<std::unique_ptr<LLVMJit>> Create(OptLevel level);
+
+  // The data layout that modules added to the JIT must be generated with.
+  const llvm::DataLayout& layout() const { return jit_->getDataLayout(); }
+
+  // Takes ownership of a module (and the context it was created in), making
+  // its definitions available for lookup. Code is generated lazily on lookup.
+  Result AddModule(std::unique_ptr<llvm::Module> module,
+                   std::unique_ptr<llvm::LLVMContext> context);
+
+  // Compiles the module's monomorphic `main` function, returning its address.
+  Failable<int64_t (*)()> LookupMain();
+
+ private:
+  explicit LLVMJit(std::unique_ptr<llvm::orc::LLJIT> jit) : jit_(std::move(jit)) {}
+
+  // Defines the runtime's symbols in the JIT's main library.
+  Result DefineRuntime();
+
+  std::unique_ptr<llvm::orc::LLJIT> jit_;
+};
+
+}  // namespace darlang::backend
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_JIT_H_
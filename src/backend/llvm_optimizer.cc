@@ -0,0 +1,72 @@
+#include "backend/llvm_optimizer.h"
+
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
+
+namespace darlang::backend {
+
+static llvm::OptimizationLevel GetLLVMLevel(OptLevel level) {
+  switch (level) {
+    case OptLevel::O0:
+      return llvm::OptimizationLevel::O0;
+    case OptLevel::O1:
+      return llvm::OptimizationLevel::O1;
+    case OptLevel::O2:
+      return llvm::OptimizationLevel::O2;
+    case OptLevel::O3:
+      return llvm::OptimizationLevel::O3;
+  }
+  assert(false);
+}
+
+/* static */
+llvm::CodeGenOpt::Level LLVMOptimizer::CodeGenLevel(OptLevel level) {
+  switch (level) {
+    case OptLevel::O0:
+      return llvm::CodeGenOpt::None;
+    case OptLevel::O1:
+      return llvm::CodeGenOpt::Less;
+    case OptLevel::O2:
+      return llvm::CodeGenOpt::Default;
+    case OptLevel::O3:
+      return llvm::CodeGenOpt::Aggressive;
+  }
+  assert(false);
+}
+
+/* static */
+void LLVMOptimizer::Optimize(llvm::Module& module,
+                             OptLevel level,
+                             bool time_passes,
+                             llvm::TargetMachine* target) {
+  // The timing handler is configured from this global on construction, and
+  // prints its report when the instrumentation is destroyed.
+  llvm::TimePassesIsEnabled = time_passes;
+
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  llvm::PassInstrumentationCallbacks pic;
+  llvm::StandardInstrumentations si(false);
+  si.registerCallbacks(pic, &fam);
+
+  llvm::PassBuilder builder(target, llvm::PipelineTuningOptions(), llvm::None, &pic);
+  builder.registerModuleAnalyses(mam);
+  builder.registerCGSCCAnalyses(cgam);
+  builder.registerFunctionAnalyses(fam);
+  builder.registerLoopAnalyses(lam);
+  builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+  llvm::ModulePassManager mpm;
+  if (level == OptLevel::O0) {
+    mpm = builder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+  } else {
+    mpm = builder.buildPerModuleDefaultPipeline(GetLLVMLevel(level));
+  }
+  mpm.run(module, mam);
+}
+
+}  // namespace darlang::backend
@@ -0,0 +1,36 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_OPTIMIZER_H_
+#define DARLANG_SRC_BACKEND_LLVM_OPTIMIZER_H_
+
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+namespace darlang::backend {
+
+enum class OptLevel {
+  O0,
+  O1,
+  O2,
+  O3,
+};
+
+// Runs LLVM's standard optimization pipelines over generated modules.
+class LLVMOptimizer {
+ public:
+  // Optimizes a module in place using the default new pass manager pipeline
+  // for the given level. If a target machine is provided, target-specific
+  // analyses (e.g. cost models) are used to guide transformations.
+  //
+  // If `time_passes` is set, a report of time spent in each pass is written
+  // to stderr once the pipeline completes.
+  static void Optimize(llvm::Module& module,
+                       OptLevel level,
+                       bool time_passes,
+                       llvm::TargetMachine* target = nullptr);
+
+  // Returns the code generator optimization level matching a pipeline level.
+  static llvm::CodeGenOpt::Level CodeGenLevel(OptLevel level);
+};
+
+}  // namespace darlang::backend
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_OPTIMIZER_H_
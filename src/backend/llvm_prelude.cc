@@ -1,9 +1,19 @@
 #include "backend/llvm_prelude.h"
 
 #include "llvm/IR/Constants.h"
+#include "llvm/Support/MathExtras.h"
+
+#include "runtime/runtime.h"
 
 namespace darlang::backend {
 
+// Allocations larger than this always call into the runtime, which may give
+// them a chunk of their own.
+static const uint64_t kMaxInlineAlloc = 1024;
+// The size of the reference count preceding each heap value. Values are thus
+// aligned to 8 bytes, which suffices for every type the backend generates.
+static const uint64_t kHeaderSize = 8;
+
 LLVMPrelude::LLVMPrelude(llvm::Module* const module, const llvm::DataLayout& layout)
     : module_(module), layout_(layout) {
   // TODO(acomminos): get platform word size
@@ -16,21 +26,146 @@ void LLVMPrelude::LoadFunctions() {
   // Use an i8* to represent a void*.
   llvm::Type* const void_ptr_type = llvm::Type::getInt8PtrTy(module_->getContext());
 
-  // Idempotently initialize required standard library functions.
-  malloc_func_ = module_->getOrInsertFunction("malloc", void_ptr_type, size_type_);
+  // Idempotently initialize required runtime functions (see runtime/runtime.h).
+  heap_type_ = llvm::StructType::getTypeByName(module_->getContext(), "darlang_heap_t");
+  if (!heap_type_) {
+    heap_type_ = llvm::StructType::create(
+        {void_ptr_type, void_ptr_type, void_ptr_type, llvm::ArrayType::get(void_ptr_type, DARLANG_SIZE_CLASSES)},
+        "darlang_heap_t");
+  }
+  heap_ = module_->getOrInsertGlobal("darlang_heap", heap_type_);
+  llvm::cast<llvm::GlobalVariable>(heap_)->setThreadLocal(true);
+
+  alloc_func_ = module_->getOrInsertFunction("darlang_alloc", void_ptr_type, size_type_);
+  free_func_ = module_->getOrInsertFunction("darlang_free", llvm::Type::getVoidTy(module_->getContext()),
+                                            void_ptr_type, size_type_);
+  reset_func_ = module_->getOrInsertFunction("darlang_heap_reset", llvm::Type::getVoidTy(module_->getContext()));
+
+  // The runtime never unwinds, and always returns.
+  for (auto callee : {alloc_func_, free_func_, reset_func_}) {
+    if (auto func = llvm::dyn_cast<llvm::Function>(callee.getCallee())) {
+      func->addFnAttr(llvm::Attribute::NoUnwind);
+      func->addFnAttr(llvm::Attribute::WillReturn);
+    }
+  }
+}
+
+uint64_t LLVMPrelude::HeapBlockSize(llvm::Type* type) const {
+  return llvm::alignTo(kHeaderSize + layout_.getTypeAllocSize(type), DARLANG_ALLOC_ALIGN);
 }
 
 llvm::Value* LLVMPrelude::CreateHeapAlloc(llvm::IRBuilder<>& builder,
-                                          llvm::Type* type) {
-  const uint64_t size = layout_.getTypeAllocSize(type);
-  llvm::CallInst* call = builder.CreateCall(malloc_func_,
-      {llvm::ConstantInt::get(size_type_, size)});
-  // After the call to malloc has been performed, cast it to a pointer to the
+                                          llvm::Type* type,
+                                          llvm::Value* reuse) {
+  auto& context = module_->getContext();
+  const uint64_t size = HeapBlockSize(type);
+
+  llvm::Value* block;
+  if (reuse) {
+    // Only allocate fresh storage if there was none to reuse.
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+    auto reuse_block = builder.GetInsertBlock();
+    auto fresh_block = llvm::BasicBlock::Create(context, "fresh", func);
+    auto init_block = llvm::BasicBlock::Create(context, "init", func);
+    builder.CreateCondBr(builder.CreateIsNull(reuse), fresh_block, init_block);
+
+    builder.SetInsertPoint(fresh_block);
+    llvm::Value* fresh = CreateHeapBlockAlloc(builder, size);
+    fresh_block = builder.GetInsertBlock();
+    builder.CreateBr(init_block);
+
+    builder.SetInsertPoint(init_block);
+    llvm::PHINode* phi = builder.CreatePHI(reuse->getType(), 2);
+    phi->addIncoming(reuse, reuse_block);
+    phi->addIncoming(fresh, fresh_block);
+    block = phi;
+  } else {
+    block = CreateHeapBlockAlloc(builder, size);
+  }
+
+  // Values start out with a single reference, held by their creator.
+  builder.CreateStore(llvm::ConstantInt::get(size_type_, 1),
+                      builder.CreateBitCast(block, size_type_->getPointerTo()));
+  llvm::Value* value = builder.CreateConstGEP1_64(builder.getInt8Ty(), block, kHeaderSize);
+
+  // After the allocation has been performed, cast it to a pointer to the
   // desired type.
   llvm::Type* const cast_type = type->getPointerTo();
   return builder.CreateCast(
-      llvm::CastInst::getCastOpcode(call, false, cast_type, false),
-      call, cast_type);
+      llvm::CastInst::getCastOpcode(value, false, cast_type, false),
+      value, cast_type);
+}
+
+llvm::Value* LLVMPrelude::CreateHeapBlockAlloc(llvm::IRBuilder<>& builder, uint64_t size) {
+  auto& context = module_->getContext();
+  llvm::Type* const void_ptr_type = llvm::Type::getInt8PtrTy(context);
+  llvm::Value* const size_value = llvm::ConstantInt::get(size_type_, size);
+
+  if (size > kMaxInlineAlloc) {
+    return builder.CreateCall(alloc_func_, {size_value});
+  }
+
+  // Pop storage freed by a value of the same size if there is any, or else
+  // bump the heap's next pointer if the current chunk has room, and fall back
+  // to the runtime otherwise.
+  llvm::Function* func = builder.GetInsertBlock()->getParent();
+  auto pop_block = llvm::BasicBlock::Create(context, "pop", func);
+  auto check_block = llvm::BasicBlock::Create(context, "check", func);
+  auto bump_block = llvm::BasicBlock::Create(context, "bump", func);
+  auto refill_block = llvm::BasicBlock::Create(context, "refill", func);
+  auto alloc_block = llvm::BasicBlock::Create(context, "alloc", func);
+
+  llvm::Value* free_addr = builder.CreateInBoundsGEP(
+      heap_type_, heap_, {builder.getInt32(0), builder.getInt32(3), builder.getInt64(size / DARLANG_ALLOC_ALIGN)});
+  llvm::Value* freed = builder.CreateLoad(void_ptr_type, free_addr);
+  builder.CreateCondBr(builder.CreateIsNull(freed), check_block, pop_block);
+
+  builder.SetInsertPoint(pop_block);
+  llvm::Value* link_addr = builder.CreateBitCast(freed, void_ptr_type->getPointerTo());
+  builder.CreateStore(builder.CreateLoad(void_ptr_type, link_addr), free_addr);
+  builder.CreateBr(alloc_block);
+
+  builder.SetInsertPoint(check_block);
+  llvm::Value* next_addr = builder.CreateStructGEP(heap_type_, heap_, 0);
+  llvm::Value* end_addr = builder.CreateStructGEP(heap_type_, heap_, 1);
+  llvm::Value* next = builder.CreateLoad(void_ptr_type, next_addr);
+  llvm::Value* end = builder.CreateLoad(void_ptr_type, end_addr);
+  llvm::Value* remaining = builder.CreateSub(builder.CreatePtrToInt(end, size_type_),
+                                             builder.CreatePtrToInt(next, size_type_));
+  llvm::Value* fits = builder.CreateICmpUGE(remaining, size_value);
+  builder.CreateCondBr(fits, bump_block, refill_block);
+
+  builder.SetInsertPoint(bump_block);
+  builder.CreateStore(builder.CreateGEP(builder.getInt8Ty(), next, size_value), next_addr);
+  builder.CreateBr(alloc_block);
+
+  builder.SetInsertPoint(refill_block);
+  llvm::Value* refilled = builder.CreateCall(alloc_func_, {size_value});
+  builder.CreateBr(alloc_block);
+
+  builder.SetInsertPoint(alloc_block);
+  llvm::PHINode* phi = builder.CreatePHI(void_ptr_type, 3);
+  phi->addIncoming(freed, pop_block);
+  phi->addIncoming(next, bump_block);
+  phi->addIncoming(refilled, refill_block);
+  return phi;
+}
+
+llvm::Value* LLVMPrelude::CreateRefCountAddr(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  return builder.CreateBitCast(CreateHeapBlock(builder, value), size_type_->getPointerTo());
+}
+
+llvm::Value* LLVMPrelude::CreateHeapBlock(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  llvm::Value* bytes = builder.CreateBitCast(value, builder.getInt8PtrTy());
+  return builder.CreateConstGEP1_64(builder.getInt8Ty(), bytes, -static_cast<int64_t>(kHeaderSize));
+}
+
+void LLVMPrelude::CreateHeapFree(llvm::IRBuilder<>& builder, llvm::Value* block, uint64_t size) {
+  builder.CreateCall(free_func_, {block, llvm::ConstantInt::get(size_type_, size)});
+}
+
+void LLVMPrelude::CreateHeapReset(llvm::IRBuilder<>& builder) {
+  builder.CreateCall(reset_func_);
 }
 
 }  // namespace darlang::backend
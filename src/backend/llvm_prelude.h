@@ -6,22 +6,57 @@
 namespace darlang::backend {
 
 // The prelude provides a simple interface to produce call instructions into
-// glibc. Its primary use currently is to provide access to glibc's heap.
+// the darlang runtime. Its primary use currently is to provide access to the
+// heap.
+//
+// Heap values are preceded by a header holding their reference count. Values
+// are addressed by a pointer past the header, leaving their layout untouched.
 class LLVMPrelude {
  public:
   LLVMPrelude(llvm::Module* const module, const llvm::DataLayout& layout);
 
-  // Inserts an instruction at the location of an IRBuilder to allocate a value
-  // of a sized type on the heap, and return a pointer to it.
-  llvm::Value* CreateHeapAlloc(llvm::IRBuilder<>& builder, llvm::Type* type);
+  // Inserts instructions at the location of an IRBuilder to allocate a value
+  // of a sized type on the heap, and return a pointer to it. Small values are
+  // allocated inline from freed storage or by bumping, leaving the builder in
+  // a new block.
+  //
+  // If `reuse` is given, it is used as the value's storage unless null. It
+  // must have been allocated for a type with the same HeapBlockSize.
+  llvm::Value* CreateHeapAlloc(llvm::IRBuilder<>& builder, llvm::Type* type,
+                               llvm::Value* reuse = nullptr);
+
+  // Returns the size of the storage backing a heap value of the given type.
+  uint64_t HeapBlockSize(llvm::Type* type) const;
+
+  // Returns the address of a heap value's reference count, an i64.
+  llvm::Value* CreateRefCountAddr(llvm::IRBuilder<>& builder, llvm::Value* value);
+
+  // Returns the storage backing a heap value, as an i8*.
+  llvm::Value* CreateHeapBlock(llvm::IRBuilder<>& builder, llvm::Value* value);
+
+  // Inserts a call returning (possibly null) heap storage to the runtime.
+  void CreateHeapFree(llvm::IRBuilder<>& builder, llvm::Value* block, uint64_t size);
+
+  // Inserts a call releasing every value allocated on the heap.
+  void CreateHeapReset(llvm::IRBuilder<>& builder);
  private:
+  // Allocates storage of the given size from freed storage or by bumping,
+  // falling back to the runtime.
+  llvm::Value* CreateHeapBlockAlloc(llvm::IRBuilder<>& builder, uint64_t size);
+
   void LoadFunctions();
 
   llvm::Module* const module_;
   const llvm::DataLayout& layout_;
   llvm::IntegerType* size_type_;
 
-  llvm::Constant* malloc_func_;
+  // The runtime's darlang_heap_t, and its (thread-local) instance.
+  llvm::StructType* heap_type_;
+  llvm::Constant* heap_;
+
+  llvm::FunctionCallee alloc_func_;
+  llvm::FunctionCallee free_func_;
+  llvm::FunctionCallee reset_func_;
 };
 
 }  // namespace darlang::backend
@@ -0,0 +1,277 @@
+#include "backend/llvm_refcount.h"
+
+#include "backend/llvm_disjoint.h"
+
+namespace darlang::backend {
+
+bool LLVMRefCounter::IsCounted(llvm::Type* type) const {
+  // Strings (i8*) point to static data, and non-recursive disjoint unions
+  // are opaque.
+  if (type->isPointerTy()) {
+    return cache_.HeapCell(type);
+  }
+  if (auto struct_type = llvm::dyn_cast<llvm::StructType>(type)) {
+    for (auto element : struct_type->elements()) {
+      if (IsCounted(element)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void LLVMRefCounter::CollectRefs(llvm::IRBuilder<>& builder, llvm::Value* value,
+                                 std::vector<llvm::Value*>& refs) const {
+  llvm::Type* type = value->getType();
+  if (type->isPointerTy()) {
+    if (IsCounted(type)) {
+      refs.push_back(value);
+    }
+    return;
+  }
+  if (auto struct_type = llvm::dyn_cast<llvm::StructType>(type)) {
+    for (unsigned int i = 0; i < struct_type->getNumElements(); i++) {
+      if (IsCounted(struct_type->getElementType(i))) {
+        CollectRefs(builder, builder.CreateExtractValue(value, i), refs);
+      }
+    }
+  }
+}
+
+std::vector<llvm::Value*> LLVMRefCounter::LoadRefs(llvm::IRBuilder<>& builder,
+                                                   llvm::StructType* type,
+                                                   llvm::Value* value) {
+  std::vector<llvm::Value*> refs;
+  for (unsigned int i = 0; i < type->getNumElements(); i++) {
+    llvm::Type* field_type = type->getElementType(i);
+    if (IsCounted(field_type)) {
+      auto field = builder.CreateLoad(field_type, builder.CreateStructGEP(type, value, i));
+      CollectRefs(builder, field, refs);
+    }
+  }
+  return refs;
+}
+
+void LLVMRefCounter::LoadMemberRefs(llvm::IRBuilder<>& builder, llvm::StructType* type, llvm::Value* value,
+                                    const ReleaseFunc& release) {
+  const LLVMDisjointLayout* layout = cache_.LookupCell(type);
+  if (!layout) {
+    release(LoadRefs(builder, type, value));
+    return;
+  }
+
+  // Members holding no references share the switch's default case. Unions
+  // without cells of their own hold a reference to their member's cell.
+  auto& context = module_->getContext();
+  auto func = builder.GetInsertBlock()->getParent();
+  bool cell = layout->kind == LLVMDisjointLayout::TAGGED;
+  auto tag = cell ? LLVMDisjoint::CreateLoadTag(builder, type, value)
+                  : LLVMDisjoint::CreateExtractTag(builder, *layout, value);
+  auto tag_type = llvm::cast<llvm::IntegerType>(tag->getType());
+  auto default_block = llvm::BasicBlock::Create(context, "member", func);
+  auto switch_inst = builder.CreateSwitch(tag, default_block);
+  for (unsigned int i = 0; i < layout->members.size(); i++) {
+    if (!IsCounted(layout->members[i])) {
+      continue;
+    }
+    auto member_block = llvm::BasicBlock::Create(context, "member", func);
+    switch_inst->addCase(llvm::ConstantInt::get(tag_type, i), member_block);
+    builder.SetInsertPoint(member_block);
+    std::vector<llvm::Value*> refs;
+    CollectRefs(builder,
+                cell ? LLVMDisjoint::CreateLoadMember(builder, type, *layout, i, value)
+                     : LLVMDisjoint::CreateExtractMember(builder, *layout, i, value),
+                refs);
+    release(refs);
+  }
+  builder.SetInsertPoint(default_block);
+  release({});
+}
+
+void LLVMRefCounter::CreateDup(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  std::vector<llvm::Value*> refs;
+  CollectRefs(builder, value, refs);
+  for (auto ref : refs) {
+    if (cache_.LookupTaggedRef(ref->getType())) {
+      ForEachFieldRef(builder, CellType(ref), ref, [&](llvm::Value* member) { CreateDup(builder, member); });
+      continue;
+    }
+    auto count_addr = prelude_.CreateRefCountAddr(builder, ref);
+    auto count = builder.CreateLoad(builder.getInt64Ty(), count_addr);
+    builder.CreateStore(builder.CreateAdd(count, builder.getInt64(1)), count_addr);
+  }
+}
+
+void LLVMRefCounter::CreateDrop(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  std::vector<llvm::Value*> refs;
+  CollectRefs(builder, value, refs);
+  for (auto ref : refs) {
+    auto call = builder.CreateCall(GetDropFunction(CellType(ref)), {ref});
+    call->setCallingConv(llvm::CallingConv::Tail);
+  }
+}
+
+llvm::StructType* LLVMRefCounter::ReuseType(llvm::Value* ref) const {
+  auto layout = cache_.LookupTaggedRef(ref->getType());
+  if (!layout) {
+    return CellType(ref);
+  }
+  llvm::StructType* reuse_type = nullptr;
+  for (auto member : layout->members) {
+    auto cell_type = cache_.HeapCell(member);
+    if (!cell_type) {
+      continue;
+    }
+    if (reuse_type && prelude_.HeapBlockSize(cell_type) != prelude_.HeapBlockSize(reuse_type)) {
+      return nullptr;
+    }
+    reuse_type = cell_type;
+  }
+  return reuse_type;
+}
+
+llvm::Value* LLVMRefCounter::CreateDropReuse(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  auto call = builder.CreateCall(GetReuseFunction(CellType(value)), {value});
+  call->setCallingConv(llvm::CallingConv::Tail);
+  return call;
+}
+
+void LLVMRefCounter::CreateDupFields(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  ForEachFieldRef(builder, CellType(value), value, [&](llvm::Value* ref) { CreateDup(builder, ref); });
+}
+
+void LLVMRefCounter::CreateDropFields(llvm::IRBuilder<>& builder, llvm::Value* value) {
+  ForEachFieldRef(builder, CellType(value), value, [&](llvm::Value* ref) { CreateDrop(builder, ref); });
+}
+
+void LLVMRefCounter::ForEachFieldRef(llvm::IRBuilder<>& builder, llvm::StructType* type, llvm::Value* value,
+                                     const std::function<void(llvm::Value*)>& apply) {
+  if (!cache_.LookupCell(type)) {
+    for (auto ref : LoadRefs(builder, type, value)) {
+      apply(ref);
+    }
+    return;
+  }
+  auto joined_block = llvm::BasicBlock::Create(module_->getContext(), "joined", builder.GetInsertBlock()->getParent());
+  LoadMemberRefs(builder, type, value, [&](const std::vector<llvm::Value*>& refs) {
+    for (auto ref : refs) {
+      apply(ref);
+    }
+    builder.CreateBr(joined_block);
+  });
+  builder.SetInsertPoint(joined_block);
+}
+
+llvm::Function* LLVMRefCounter::GetDropFunction(llvm::StructType* type) {
+  auto it = drop_funcs_.find(type);
+  if (it != drop_funcs_.end()) {
+    return it->second;
+  }
+
+  auto& context = module_->getContext();
+  auto func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), {type->getPointerTo()}, false);
+  auto func = llvm::Function::Create(func_type, llvm::Function::InternalLinkage,
+                                     "darlang.drop_" + cache_.Symbol(type), module_);
+  func->setCallingConv(llvm::CallingConv::Tail);
+  drop_funcs_[type] = func;
+
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", func));
+  llvm::Value* value = func->getArg(0);
+
+  // References to unions without cells of their own release their member's.
+  if (cache_.LookupTaggedRef(value->getType())) {
+    LoadMemberRefs(builder, type, value, [&](const std::vector<llvm::Value*>& refs) {
+      for (auto ref : refs) {
+        auto call = builder.CreateCall(GetDropFunction(CellType(ref)), {ref});
+        call->setCallingConv(llvm::CallingConv::Tail);
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+      }
+      builder.CreateRetVoid();
+    });
+    return func;
+  }
+
+  auto dec_block = llvm::BasicBlock::Create(context, "dec", func);
+  auto free_block = llvm::BasicBlock::Create(context, "free", func);
+
+  auto count_addr = prelude_.CreateRefCountAddr(builder, value);
+  auto count = builder.CreateLoad(builder.getInt64Ty(), count_addr);
+  builder.CreateCondBr(builder.CreateICmpEQ(count, builder.getInt64(1)), free_block, dec_block);
+
+  builder.SetInsertPoint(dec_block);
+  builder.CreateStore(builder.CreateSub(count, builder.getInt64(1)), count_addr);
+  builder.CreateRetVoid();
+
+  // Free the value before releasing its fields, so that releasing the last
+  // field can be a tail call. Long lists are then freed in constant stack.
+  builder.SetInsertPoint(free_block);
+  LoadMemberRefs(builder, type, value, [&](const std::vector<llvm::Value*>& refs) {
+    prelude_.CreateHeapFree(builder, prelude_.CreateHeapBlock(builder, value), prelude_.HeapBlockSize(type));
+    for (auto ref : refs) {
+      auto call = builder.CreateCall(GetDropFunction(CellType(ref)), {ref});
+      call->setCallingConv(llvm::CallingConv::Tail);
+      if (ref == refs.back()) {
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+      }
+    }
+    builder.CreateRetVoid();
+  });
+  return func;
+}
+
+llvm::Function* LLVMRefCounter::GetReuseFunction(llvm::StructType* type) {
+  auto it = reuse_funcs_.find(type);
+  if (it != reuse_funcs_.end()) {
+    return it->second;
+  }
+
+  auto& context = module_->getContext();
+  auto block_type = llvm::Type::getInt8PtrTy(context);
+  auto func_type = llvm::FunctionType::get(block_type, {type->getPointerTo()}, false);
+  auto func = llvm::Function::Create(func_type, llvm::Function::InternalLinkage,
+                                     "darlang.reuse_" + cache_.Symbol(type), module_);
+  func->setCallingConv(llvm::CallingConv::Tail);
+  reuse_funcs_[type] = func;
+
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", func));
+  llvm::Value* value = func->getArg(0);
+
+  // References to unions without cells of their own reclaim their member's,
+  // if it has one.
+  if (cache_.LookupTaggedRef(value->getType())) {
+    LoadMemberRefs(builder, type, value, [&](const std::vector<llvm::Value*>& refs) {
+      if (refs.empty()) {
+        builder.CreateRet(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(block_type)));
+        return;
+      }
+      assert(refs.size() == 1);
+      auto call = builder.CreateCall(GetReuseFunction(CellType(refs[0])), {refs[0]});
+      call->setCallingConv(llvm::CallingConv::Tail);
+      call->setTailCallKind(llvm::CallInst::TCK_Tail);
+      builder.CreateRet(call);
+    });
+    return func;
+  }
+
+  auto dec_block = llvm::BasicBlock::Create(context, "dec", func);
+  auto reuse_block = llvm::BasicBlock::Create(context, "reuse", func);
+
+  auto count_addr = prelude_.CreateRefCountAddr(builder, value);
+  auto count = builder.CreateLoad(builder.getInt64Ty(), count_addr);
+  builder.CreateCondBr(builder.CreateICmpEQ(count, builder.getInt64(1)), reuse_block, dec_block);
+
+  builder.SetInsertPoint(dec_block);
+  builder.CreateStore(builder.CreateSub(count, builder.getInt64(1)), count_addr);
+  builder.CreateRet(llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(block_type)));
+
+  builder.SetInsertPoint(reuse_block);
+  LoadMemberRefs(builder, type, value, [&](const std::vector<llvm::Value*>& refs) {
+    for (auto ref : refs) {
+      CreateDrop(builder, ref);
+    }
+    builder.CreateRet(prelude_.CreateHeapBlock(builder, value));
+  });
+  return func;
+}
+
+}  // namespace darlang::backend
@@ -0,0 +1,97 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_REFCOUNT_H_
+#define DARLANG_SRC_BACKEND_LLVM_REFCOUNT_H_
+
+#include <cassert>
+#include <functional>
+#include <unordered_map>
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include "backend/llvm_prelude.h"
+#include "backend/llvm_typer.h"
+
+namespace darlang::backend {
+
+// Emits reference counting operations on heap values. Recursive tuples are
+// counted directly, and tuples passed by value are counted through the heap
+// values they contain.
+//
+// Values are released through generated drop functions, one per heap type,
+// which free a value's storage once its last reference is dropped and then
+// release its fields in turn. Cells of recursive unions release the fields of
+// whichever member they hold, and references to recursive unions without
+// cells of their own (see LLVMTypeCache::LookupTaggedRef) release the cell of
+// whichever member they point to.
+class LLVMRefCounter {
+ public:
+  LLVMRefCounter(llvm::Module* module, LLVMPrelude& prelude, LLVMTypeCache& cache)
+    : module_(module), prelude_(prelude), cache_(cache) {}
+
+  // Returns true if values of the given type hold references to heap values.
+  bool IsCounted(llvm::Type* type) const;
+
+  // Returns the struct type of the heap value a reference points to.
+  llvm::StructType* CellType(llvm::Value* ref) const {
+    auto struct_type = cache_.HeapCell(ref->getType());
+    assert(struct_type);
+    return struct_type;
+  }
+
+  // Inserts instructions acquiring an additional reference to a value.
+  void CreateDup(llvm::IRBuilder<>& builder, llvm::Value* value);
+
+  // Inserts instructions releasing a reference to a value.
+  void CreateDrop(llvm::IRBuilder<>& builder, llvm::Value* value);
+
+  // Returns the struct type of the storage reclaimed by CreateDropReuse from
+  // a reference, or nullptr if it may vary in size (between union members).
+  llvm::StructType* ReuseType(llvm::Value* ref) const;
+
+  // Inserts instructions releasing a reference to a heap value. If it was the
+  // last reference, the value's fields are released and its storage returned
+  // (as an i8*) for reuse. Otherwise, null is returned.
+  llvm::Value* CreateDropReuse(llvm::IRBuilder<>& builder, llvm::Value* value);
+
+  // Inserts instructions acquiring or releasing references to the fields of
+  // a tuple or union cell outside of the heap, such as on the stack. Each
+  // reference to such a value holds a reference to each of its fields.
+  void CreateDupFields(llvm::IRBuilder<>& builder, llvm::Value* value);
+  void CreateDropFields(llvm::IRBuilder<>& builder, llvm::Value* value);
+
+ private:
+  // Appends the heap values referenced by a value to `refs`.
+  void CollectRefs(llvm::IRBuilder<>& builder, llvm::Value* value,
+                   std::vector<llvm::Value*>& refs) const;
+
+  // Returns the helpers releasing a heap value of the given struct type, or
+  // reclaiming its storage. Each is named after the darlang type it was
+  // lowered from.
+  llvm::Function* GetDropFunction(llvm::StructType* type);
+  llvm::Function* GetReuseFunction(llvm::StructType* type);
+
+  // Loads the fields of a heap value and collects their references.
+  std::vector<llvm::Value*> LoadRefs(llvm::IRBuilder<>& builder, llvm::StructType* type,
+                                     llvm::Value* value);
+
+  // Calls `release` with the references held by a heap value, with the
+  // builder positioned after they are loaded. Union cells switch over their
+  // tag, calling `release` once per member from a block of its own, which it
+  // must terminate.
+  using ReleaseFunc = std::function<void(const std::vector<llvm::Value*>& refs)>;
+  void LoadMemberRefs(llvm::IRBuilder<>& builder, llvm::StructType* type, llvm::Value* value,
+                      const ReleaseFunc& release);
+  // Calls `apply` with each reference held by a value outside of the heap,
+  // leaving the builder where the paths taken over a cell's members rejoin.
+  void ForEachFieldRef(llvm::IRBuilder<>& builder, llvm::StructType* type, llvm::Value* value,
+                       const std::function<void(llvm::Value*)>& apply);
+
+  llvm::Module* module_;
+  LLVMPrelude& prelude_;
+  LLVMTypeCache& cache_;
+  std::unordered_map<llvm::StructType*, llvm::Function*> drop_funcs_;
+  std::unordered_map<llvm::StructType*, llvm::Function*> reuse_funcs_;
+};
+
+}  // namespace darlang::backend
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_REFCOUNT_H_
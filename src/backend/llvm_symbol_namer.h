@@ -1,6 +1,7 @@
 #ifndef DARLANG_SRC_BACKEND_LLVM_SYMBOL_NAMER_H_
 #define DARLANG_SRC_BACKEND_LLVM_SYMBOL_NAMER_H_
 
+#include "ast/types.h"
 #include "typing/types.h"
 #include <sstream>
 
@@ -40,9 +41,19 @@ class LLVMSymbolNamer : public typing::Type::Visitor {
     return fname + "_" + Name(type);
   }
 
+  // Returns the symbol for a specialization of the given declaration.
+  // Unexported declarations (e.g. main) are monomorphic, and retain their
+  // unmangled name.
+  static std::string Specialization(const ast::DeclarationNode& decl, typing::Type& func_type) {
+    if (decl.exported) {
+      return Declaration(decl.name, func_type);
+    }
+    return decl.name;
+  }
+
   // Given a function name and list of argument types, returns the appropriate
   // implementation function symbol.
-  static std::string Call(std::string fname, std::vector<std::unique_ptr<typing::Type>>& args) {
+  static std::string Call(std::string fname, const std::vector<typing::Type*>& args) {
     return fname + "_" + FunctionSignature(args);
   }
 
@@ -98,7 +109,8 @@ class LLVMSymbolNamer : public typing::Type::Visitor {
  private:
   // Factored out to share code for function name generation between
   // instantiated function types and calls.
-  static std::string FunctionSignature(const std::vector<std::unique_ptr<typing::Type>>& args) {
+  template <typename TypePtr>
+  static std::string FunctionSignature(const std::vector<TypePtr>& args) {
     std::stringstream ss;
     ss << "F";
     ss << args.size();
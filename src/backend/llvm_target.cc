@@ -0,0 +1,103 @@
+#include "backend/llvm_target.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+
+namespace darlang::backend {
+
+/* static */
+Failable<std::unique_ptr<llvm::TargetMachine>> LLVMTarget::CreateHostMachine(
+    const std::string& cpu, const std::string& features, OptLevel level) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string error;
+  auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    return Result::Error(ErrorCode::TARGET_UNSUPPORTED, error);
+  }
+
+  std::string target_cpu = cpu;
+  llvm::SubtargetFeatures target_features;
+  if (cpu == "native") {
+    target_cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+      for (auto& feature : host_features) {
+        target_features.AddFeature(feature.first(), feature.second);
+      }
+    }
+  }
+  if (!features.empty()) {
+    target_features.AddFeature(features);
+  }
+
+  // Generate position independent code, as the system linker may default to
+  // producing position independent executables.
+  llvm::TargetOptions options;
+  std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+      triple, target_cpu, target_features.getString(), options,
+      llvm::Reloc::PIC_, llvm::None, LLVMOptimizer::CodeGenLevel(level)));
+  if (!machine) {
+    return Result::Error(ErrorCode::TARGET_UNSUPPORTED, "failed to create target machine for " + triple);
+  }
+  return std::move(machine);
+}
+
+/* static */
+uint64_t LLVMTarget::MaxDirectAggregateSize(const llvm::Triple& triple) {
+  // Follow the limits the platform's C ABI places on aggregates passed in
+  // registers: two general purpose registers on most targets (e.g. the two
+  // eightbytes of the x86-64 SysV ABI, or AAPCS64 composites), and the four
+  // core argument registers of 32-bit ARM.
+  switch (triple.getArch()) {
+    case llvm::Triple::arm:
+    case llvm::Triple::thumb:
+      return 16;
+    default:
+      return triple.isArch64Bit() ? 16 : 8;
+  }
+}
+
+/* static */
+Result LLVMTarget::EmitObject(llvm::Module& module, llvm::TargetMachine& machine,
+                              llvm::raw_pwrite_stream& os) {
+  assert(module.getTargetTriple() == machine.getTargetTriple().str());
+  assert(module.getDataLayout() == machine.createDataLayout());
+
+  // Code generation is still driven by the legacy pass manager.
+  llvm::legacy::PassManager pm;
+  if (machine.addPassesToEmitFile(pm, os, nullptr, llvm::CGFT_ObjectFile)) {
+    return Result::Error(ErrorCode::CODEGEN_FAILED, "target cannot emit object files");
+  }
+  pm.run(module);
+  os.flush();
+  return Result::Ok();
+}
+
+/* static */
+Result LLVMTarget::LinkExecutable(const std::string& object_path,
+                                  const std::string& runtime_path,
+                                  const std::string& output_path) {
+  auto cc = llvm::sys::findProgramByName("cc");
+  if (!cc) {
+    return Result::Error(ErrorCode::LINK_FAILED, "could not find a C compiler (cc) to link with");
+  }
+
+  llvm::StringRef args[] = {*cc, "-o", output_path, object_path, runtime_path};
+  std::string error;
+  int status = llvm::sys::ExecuteAndWait(*cc, args, llvm::None, {}, 0, 0, &error);
+  if (status != 0) {
+    std::string message = error.empty() ? "cc exited with status " + std::to_string(status) : error;
+    return Result::Error(ErrorCode::LINK_FAILED, message);
+  }
+  return Result::Ok();
+}
+
+}  // namespace darlang::backend
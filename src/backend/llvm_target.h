@@ -0,0 +1,43 @@
+#ifndef DARLANG_SRC_BACKEND_LLVM_TARGET_H_
+#define DARLANG_SRC_BACKEND_LLVM_TARGET_H_
+
+#include <memory>
+#include <string>
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "backend/llvm_optimizer.h"
+#include "errors.h"
+
+namespace darlang::backend {
+
+// Produces native code for the host machine from LLVM modules.
+class LLVMTarget {
+ public:
+  // Creates a target machine for the host's triple. `cpu` may be "native" to
+  // select the host's CPU and all of its supported features, in which case
+  // `features` are applied on top of the detected features.
+  static Failable<std::unique_ptr<llvm::TargetMachine>> CreateHostMachine(
+      const std::string& cpu, const std::string& features, OptLevel level);
+
+  // Returns the size of the largest tuple the target's calling convention
+  // passes in registers, above which tuples are passed through memory.
+  static uint64_t MaxDirectAggregateSize(const llvm::Triple& triple);
+
+  // Writes an object file for a module to the given stream. The module's
+  // triple and data layout must match the target machine.
+  static Result EmitObject(llvm::Module& module, llvm::TargetMachine& machine,
+                           llvm::raw_pwrite_stream& os);
+
+  // Links an object file against the darlang runtime into an executable,
+  // using the system's C compiler driver.
+  static Result LinkExecutable(const std::string& object_path,
+                               const std::string& runtime_path,
+                               const std::string& output_path);
+};
+
+}  // namespace darlang::backend
+
+#endif  // DARLANG_SRC_BACKEND_LLVM_TARGET_H_
@@ -1,29 +1,58 @@
 #include "backend/llvm_typer.h"
-#include "llvm/IR/DataLayout.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "backend/llvm_symbol_namer.h"
 
 namespace darlang {
 namespace backend {
 
+template <typename T>
+static void AddABIAttributes(const LLVMFunctionABI& abi, llvm::LLVMContext& context, T* func_or_call) {
+  if (abi.sret) {
+    func_or_call->addParamAttr(0, llvm::Attribute::getWithStructRetType(context, abi.sret));
+    func_or_call->addParamAttr(0, llvm::Attribute::NoAlias);
+  }
+  for (unsigned int i = 0; i < abi.byval.size(); i++) {
+    if (abi.byval[i]) {
+      func_or_call->addParamAttr(abi.ParamIndex(i), llvm::Attribute::getWithByValType(context, abi.byval[i]));
+    }
+  }
+}
+
+void LLVMFunctionABI::AddAttributes(llvm::Function* func) const {
+  AddABIAttributes(*this, func->getContext(), func);
+}
+
+void LLVMFunctionABI::AddAttributes(llvm::CallInst* call) const {
+  AddABIAttributes(*this, call->getContext(), call);
+}
+
+const LLVMTypeCache::TypeLayout& LLVMTypeCache::GetLayout(llvm::Type* type) {
+  auto it = layouts_.find(type);
+  if (it != layouts_.end()) {
+    return it->second;
+  }
+  assert(type->isSized());
+  TypeLayout type_layout = {layout_.getTypeAllocSize(type), layout_.getABITypeAlign(type)};
+  return layouts_.emplace(type, type_layout).first->second;
+}
+
 /* static */
 llvm::Type* LLVMTypeGenerator::Generate(llvm::LLVMContext& context, typing::Type& type, LLVMTypeCache& cache) {
   LLVMTypeGenerator generator(context, cache);
   type.Visit(generator);
   llvm::Type* result = generator.result();
-  if (result->isStructTy() && type.recursive()) {
+  if (result->isStructTy() && (type.recursive() || cache.LookupCell(result))) {
     // Darlang requires all recursive types to be passed via pointer, as the
     // function polymorpher does not permit variadic return types to implement
     // heap-allocated recurrences.
-    return result->getPointerTo();
+    return cache.InsertHeapCell(llvm::cast<llvm::StructType>(result));
   }
   return result;
 }
 
-llvm::Type* LLVMTypeGenerator::Generate(llvm::LLVMContext& context, typing::TypeablePtr& typeable, LLVMTypeCache& cache) {
-  std::unique_ptr<typing::Type> type;
-  assert(typeable->Solve(type));
-  return Generate(context, *type, cache);
-}
-
 LLVMTypeGenerator::LLVMTypeGenerator(llvm::LLVMContext& context, LLVMTypeCache& cache)
   : context_(context), cache_(cache), result_(nullptr) {
 }
@@ -58,25 +87,109 @@ void LLVMTypeGenerator::Type(typing::Tuple& tuple) {
 
   llvm::StructType* tuple_type = llvm::StructType::create(context_);
   cache_.Insert(tuple, tuple_type);
+  cache_.InsertSymbol(tuple_type, LLVMSymbolNamer::Name(tuple));
 
   std::vector<llvm::Type*> item_types;
+  bool sized = true;
   for (auto& tuple_item : tuple.types()) {
     auto& type = std::get<std::unique_ptr<typing::Type>>(tuple_item);
     item_types.push_back(LLVMTypeGenerator::Generate(context_, *type, cache_));
+    sized &= item_types.back()->isSized();
+  }
+
+  // Items are only ever addressed by the backend, so are free to be laid out
+  // from most to least aligned, leaving padding only at the end.
+  std::vector<unsigned int> order(item_types.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (sized) {
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+      return cache_.Alignment(item_types[a]) > cache_.Alignment(item_types[b]);
+    });
   }
 
-  tuple_type->setBody(item_types);
+  std::vector<llvm::Type*> field_types;
+  std::vector<unsigned int> fields(item_types.size());
+  for (unsigned int i = 0; i < order.size(); i++) {
+    field_types.push_back(item_types[order[i]]);
+    fields[order[i]] = i;
+  }
+  if (!std::is_sorted(order.begin(), order.end())) {
+    cache_.InsertFields(tuple_type, std::move(fields));
+  }
+
+  tuple_type->setBody(field_types);
   result_ = tuple_type;
 }
 
 void LLVMTypeGenerator::Type(typing::Function& func) {
-  // FIXME(acomminos): add function stub here
+  // Wide tuples would otherwise be split across many registers or copied
+  // through hidden temporaries. Pass them by pointer to a copy instead, and
+  // store wide results to a slot provided by the caller.
+  LLVMFunctionABI abi;
+  std::vector<llvm::Type*> param_types;
   llvm::Type* yield_type = LLVMTypeGenerator::Generate(context_, *func.yields(), cache_);
-  std::vector<llvm::Type*> arg_types(func.arguments().size());
-  for (unsigned int i = 0; i < func.arguments().size(); i++) {
-    arg_types[i] = LLVMTypeGenerator::Generate(context_, *func.arguments()[i], cache_);
+  if (cache_.IsIndirect(yield_type)) {
+    abi.sret = yield_type;
+    param_types.push_back(yield_type->getPointerTo());
+    yield_type = llvm::Type::getVoidTy(context_);
   }
-  result_ = llvm::FunctionType::get(yield_type, arg_types, false);
+  bool indirect = abi.sret;
+  for (auto& arg : func.arguments()) {
+    llvm::Type* arg_type = LLVMTypeGenerator::Generate(context_, *arg, cache_);
+    if (cache_.IsIndirect(arg_type)) {
+      abi.byval.push_back(arg_type);
+      param_types.push_back(arg_type->getPointerTo());
+      indirect = true;
+    } else {
+      abi.byval.push_back(nullptr);
+      param_types.push_back(arg_type);
+    }
+  }
+
+  auto func_type = llvm::FunctionType::get(yield_type, param_types, false);
+  if (indirect) {
+    cache_.InsertABI(func_type, std::move(abi));
+  }
+  result_ = func_type;
+}
+
+// Returns true if a type is the unit type, i.e. the empty tuple.
+static bool IsUnit(const typing::Type& type) {
+  auto tuple = dynamic_cast<const typing::Tuple*>(&type);
+  return tuple && tuple->types().empty();
+}
+
+// Returns true if a type refers back to one of its parents.
+static bool HasRecurrence(const typing::Type& type) {
+  if (dynamic_cast<const typing::Recurrence*>(&type)) {
+    return true;
+  }
+  if (auto tuple = dynamic_cast<const typing::Tuple*>(&type)) {
+    for (auto& item : tuple->types()) {
+      if (HasRecurrence(*std::get<std::unique_ptr<typing::Type>>(item))) {
+        return true;
+      }
+    }
+  }
+  if (auto disjoint = dynamic_cast<const typing::DisjointUnion*>(&type)) {
+    for (auto& member : disjoint->types()) {
+      if (HasRecurrence(*member)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Returns true if a union member, lowered to `member`, is referenced by
+// pointer to a tuple's heap cell. Such references are never null, nor point
+// into another union.
+static bool IsTupleCell(const typing::Type& type, llvm::Type* member, const LLVMTypeCache& cache) {
+  const typing::Type* target = &type;
+  if (auto recurrence = dynamic_cast<const typing::Recurrence*>(target)) {
+    target = recurrence->parent_type();
+  }
+  return dynamic_cast<const typing::Tuple*>(target) && !IsUnit(*target) && cache.HeapCell(member);
 }
 
 void LLVMTypeGenerator::Type(typing::DisjointUnion& disjoint) {
@@ -86,28 +199,105 @@ void LLVMTypeGenerator::Type(typing::DisjointUnion& disjoint) {
   }
 
   // A disjoint union is represented in IR by a type index, as well as a
-  // segment of data large enough to store the largest subtype.
+  // segment of data large enough (and aligned enough) to store any subtype.
   assert(disjoint.types().size() <= UINT32_MAX);
 
   llvm::StructType* disjoint_type = llvm::StructType::create(context_, disjoint.Hash());
   // Store intermediate types along the current path in case a subtype is
   // recursive.
   cache_.Insert(disjoint, disjoint_type);
+  cache_.InsertSymbol(disjoint_type, LLVMSymbolNamer::Name(disjoint));
 
-  llvm::Type* index_type = llvm::Type::getInt32Ty(context_);
-  uint64_t max_bytes = 0;
+  LLVMDisjointLayout layout;
+  int num_units = 0;
+  bool all_pointers = true;
   for (auto& type : disjoint.types()) {
-    // FIXME(acomminos): don't use default data layout, share with module
-    llvm::DataLayout layout("");
     llvm::Type* subtype = LLVMTypeGenerator::Generate(context_, *type, cache_);
-    auto bytes = layout.getTypeAllocSize(subtype);
-    max_bytes = bytes > max_bytes ? bytes : max_bytes;
+    // Members referring back to the union are recursive values in their own
+    // right, which are always passed by pointer.
+    if (subtype->isStructTy() && HasRecurrence(*type)) {
+      subtype = cache_.InsertHeapCell(llvm::cast<llvm::StructType>(subtype));
+    }
+    layout.members.push_back(subtype);
+    num_units += IsUnit(*type);
+    all_pointers &= subtype->isPointerTy();
+  }
+
+  // Recursive unions are referenced through the struct created above, and so
+  // must keep it as their representation. So must unions nested within a
+  // recursive type, which may be rooted at the union itself elsewhere.
+  uint64_t tag_bits = llvm::Log2_64_Ceil(layout.members.size());
+  bool recursive = disjoint.recursive() || HasRecurrence(disjoint);
+  if (recursive) {
+    // Unions of heap cells need no cell of their own, and are instead
+    // referenced by a pointer straight to their member's cell, typed as
+    // pointing to the (opaque) struct. Cells are aligned to at least a
+    // pointer, as they contain one.
+    int num_cells = 0;
+    for (unsigned int i = 0; i < layout.members.size(); i++) {
+      num_cells += IsTupleCell(*disjoint.types()[i], layout.members[i], cache_);
+    }
+    bool nullable = layout.members.size() == 2 && num_units == 1 && num_cells == 1;
+    bool aligned = num_cells == static_cast<int>(layout.members.size()) &&
+                   tag_bits <= llvm::Log2(cache_.layout().getPointerABIAlignment(0));
+    if (nullable || aligned) {
+      layout.kind = nullable ? LLVMDisjointLayout::NULLABLE : LLVMDisjointLayout::POINTER_TAGGED;
+      cache_.InsertDisjoint(disjoint, std::move(layout));
+      cache_.InsertCell(disjoint, disjoint_type);
+      result_ = disjoint_type;
+      return;
+    }
+  } else {
+    llvm::Type* ptr_type = llvm::Type::getInt8PtrTy(context_);
+
+    // Values never point to null, leaving it free to represent the unit.
+    if (layout.members.size() == 2 && num_units == 1 &&
+        (layout.members[0]->isPointerTy() || layout.members[1]->isPointerTy())) {
+      layout.kind = LLVMDisjointLayout::NULLABLE;
+      cache_.Insert(disjoint, ptr_type);
+      cache_.InsertDisjoint(disjoint, std::move(layout));
+      result_ = ptr_type;
+      return;
+    }
+
+    // Pointers to aligned values have their low bits clear.
+    bool aligned = all_pointers;
+    for (auto member : layout.members) {
+      auto pointee = cache_.HeapCell(member);
+      aligned &= pointee && pointee->isSized() && llvm::Log2(cache_.Alignment(pointee)) >= tag_bits;
+    }
+    if (aligned) {
+      layout.kind = LLVMDisjointLayout::POINTER_TAGGED;
+      cache_.Insert(disjoint, ptr_type);
+      cache_.InsertDisjoint(disjoint, std::move(layout));
+      result_ = ptr_type;
+      return;
+    }
   }
 
+  uint64_t max_bytes = 0;
+  llvm::Align max_align;
+  for (auto member : layout.members) {
+    max_bytes = std::max(max_bytes, cache_.AllocSize(member));
+    max_align = std::max(max_align, cache_.Alignment(member));
+  }
+
+  // Use the narrowest byte-addressable tag distinguishing all members.
+  unsigned int index_bits = std::max<uint64_t>(8, llvm::PowerOf2Ceil(tag_bits));
+  llvm::Type* index_type = llvm::Type::getIntNTy(context_, index_bits);
+
+  // Store the data as words of the strictest alignment of any subtype, so that
+  // each may be loaded from it in place.
+  uint64_t word_bytes = max_align.value();
   llvm::Type* data_type = llvm::ArrayType::get(
-      llvm::Type::getInt8Ty(context_), max_bytes);
+      llvm::Type::getIntNTy(context_, word_bytes * 8), llvm::alignTo(max_bytes, max_align) / word_bytes);
 
   disjoint_type->setBody({index_type, data_type});
+  layout.kind = LLVMDisjointLayout::TAGGED;
+  cache_.InsertDisjoint(disjoint, std::move(layout));
+  if (recursive) {
+    cache_.InsertCell(disjoint, disjoint_type);
+  }
   result_ = disjoint_type;
 }
 
@@ -1,23 +1,76 @@
 #ifndef DARLANG_SRC_BACKEND_LLVM_TYPER_H_
 #define DARLANG_SRC_BACKEND_LLVM_TYPER_H_
 
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Type.h"
 
+#include <cstdint>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
-#include "typing/typeable.h"
 #include "typing/types.h"
 
 namespace darlang {
 namespace backend {
 
+// Describes how a lowered disjoint union distinguishes its members. Members
+// are tagged by their index within the union.
+struct LLVMDisjointLayout {
+  enum Kind {
+    // A struct of the narrowest integer tag fitting all members, followed by
+    // storage for the largest member.
+    TAGGED,
+    // An i8* holding the pointer member, or null for the unit member.
+    // Recursive unions use a pointer to their opaque struct instead.
+    NULLABLE,
+    // An i8* holding one of several pointer members, offset by their tag. All
+    // members are aligned to leave the tag's bits clear. As above, recursive
+    // unions point to their opaque struct.
+    POINTER_TAGGED,
+  };
+
+  Kind kind;
+  // Lowered types of each member, indexed by tag.
+  std::vector<llvm::Type*> members;
+};
+
+// Describes how a lowered function type passes aggregates too large to be
+// passed directly in registers, if any.
+struct LLVMFunctionABI {
+  // The type of a result stored through a leading `sret` pointer, rather than
+  // returned, or nullptr if returned directly.
+  llvm::Type* sret = nullptr;
+  // The type of each argument passed through a `byval` pointer, or nullptr if
+  // passed directly. Indexed by argument, excluding any `sret` pointer.
+  std::vector<llvm::Type*> byval;
+
+  // Returns the index of the parameter holding the given argument.
+  unsigned int ParamIndex(unsigned int arg) const { return sret ? arg + 1 : arg; }
+
+  // Adds the attributes describing indirect parameters to a function, or a
+  // call to one.
+  void AddAttributes(llvm::Function* func) const;
+  void AddAttributes(llvm::CallInst* call) const;
+};
+
 // In order to implement recursive types, structs must not be defined literally.
 // We still want to unique these structs however, which can be done by storing a
 // mapping of type hashes to llvm::Type* instances for a context.
+//
+// Lowered types are laid out according to the data layout of the target
+// module, whose results are cached per type. Structs larger than
+// `max_direct_size` bytes are passed to and returned from functions through
+// memory.
 class LLVMTypeCache {
  public:
+  explicit LLVMTypeCache(const llvm::DataLayout& layout, uint64_t max_direct_size = UINT64_MAX)
+    : layout_(layout), max_direct_size_(max_direct_size) {}
+
   llvm::Type* Lookup(const typing::Type& type) {
     return types_[type.Hash()];
   }
@@ -25,16 +78,127 @@ class LLVMTypeCache {
     types_[type.Hash()] = llvm_type;
   }
 
+  // Returns the layout of a lowered disjoint union, or nullptr if the type is
+  // not a disjoint union or has yet to be lowered.
+  const LLVMDisjointLayout* LookupDisjoint(const typing::Type& type) const {
+    auto it = disjoints_.find(type.Hash());
+    return it != disjoints_.end() ? &it->second : nullptr;
+  }
+  void InsertDisjoint(const typing::Type& type, LLVMDisjointLayout layout) {
+    disjoints_[type.Hash()] = std::move(layout);
+  }
+
+  // Returns the layout of a recursive union given the struct type of its
+  // heap cells, or nullptr if the type is not such a cell. Unions that are
+  // not TAGGED have no cells of their own, and their struct is opaque.
+  const LLVMDisjointLayout* LookupCell(llvm::Type* cell_type) const {
+    auto it = cells_.find(cell_type);
+    return it != cells_.end() ? it->second : nullptr;
+  }
+  void InsertCell(const typing::Type& type, llvm::StructType* cell_type) {
+    cells_[cell_type] = &disjoints_.at(type.Hash());
+  }
+
+  // Returns the layout of a recursive union referenced by a tagged pointer to
+  // the cell of one of its members, rather than to a cell of its own, or
+  // nullptr if the pointer type references anything else.
+  const LLVMDisjointLayout* LookupTaggedRef(llvm::Type* ptr_type) const {
+    auto cell_type = HeapCell(ptr_type);
+    auto layout = cell_type ? LookupCell(cell_type) : nullptr;
+    return layout && layout->kind != LLVMDisjointLayout::TAGGED ? layout : nullptr;
+  }
+
+  // Returns the struct type of the reference counted heap cells referenced by
+  // a pointer type (i.e. recursive tuples and unions), or nullptr if it points
+  // to anything else, such as strings. Element types are tracked here rather
+  // than read back from pointer types.
+  llvm::StructType* HeapCell(llvm::Type* ptr_type) const {
+    auto it = heap_cells_.find(ptr_type);
+    return it != heap_cells_.end() ? it->second : nullptr;
+  }
+  // Records that values of a struct type live in heap cells, returning the
+  // type of references to them.
+  llvm::PointerType* InsertHeapCell(llvm::StructType* struct_type) {
+    auto ptr_type = struct_type->getPointerTo();
+    heap_cells_[ptr_type] = struct_type;
+    return ptr_type;
+  }
+
+  // Returns the symbol of the darlang type a struct was lowered from (see
+  // LLVMSymbolNamer), naming helpers generated per type.
+  const std::string& Symbol(llvm::Type* struct_type) const {
+    return symbols_.at(struct_type);
+  }
+  void InsertSymbol(llvm::Type* struct_type, std::string symbol) {
+    symbols_[struct_type] = std::move(symbol);
+  }
+
+  // Returns the index of a tuple item within the fields of its lowered struct,
+  // which may be reordered to reduce padding.
+  unsigned int FieldIndex(llvm::Type* struct_type, unsigned int item) const {
+    auto it = fields_.find(struct_type);
+    return it != fields_.end() ? it->second[item] : item;
+  }
+  void InsertFields(llvm::Type* struct_type, std::vector<unsigned int> fields) {
+    fields_[struct_type] = std::move(fields);
+  }
+
+  // Returns the ABI of a lowered function type, or nullptr if all of its
+  // arguments and result are passed directly.
+  const LLVMFunctionABI* LookupABI(llvm::FunctionType* func_type) const {
+    auto it = abis_.find(func_type);
+    return it != abis_.end() ? &it->second : nullptr;
+  }
+  void InsertABI(llvm::FunctionType* func_type, LLVMFunctionABI abi) {
+    abis_[func_type] = std::move(abi);
+  }
+
+  // Returns true if values of the given type are passed through memory,
+  // rather than directly.
+  bool IsIndirect(llvm::Type* type) {
+    return type->isStructTy() && type->isSized() && AllocSize(type) > max_direct_size_;
+  }
+
+  // Returns the number of bytes occupied by a (sized) value of the given type,
+  // including any padding required to store it in an array.
+  uint64_t AllocSize(llvm::Type* type) { return GetLayout(type).size; }
+  // Returns the ABI alignment of the given type.
+  llvm::Align Alignment(llvm::Type* type) { return GetLayout(type).align; }
+
+  const llvm::DataLayout& layout() const { return layout_; }
+
  private:
+  struct TypeLayout {
+    uint64_t size;
+    llvm::Align align;
+  };
+
+  const TypeLayout& GetLayout(llvm::Type* type);
+
+  const llvm::DataLayout& layout_;
+  const uint64_t max_direct_size_;
   // A mapping from type hashes to llvm::Type* instances.
   std::unordered_map<std::string, llvm::Type*> types_;
+  // Symbols of the darlang types that structs were lowered from.
+  std::unordered_map<llvm::Type*, std::string> symbols_;
+  // Field indices of each tuple item, for structs whose fields are reordered.
+  std::unordered_map<llvm::Type*, std::vector<unsigned int>> fields_;
+  // Layouts of lowered disjoint unions, by type hash.
+  std::unordered_map<std::string, LLVMDisjointLayout> disjoints_;
+  // Struct types of heap cells, by the type of references to them.
+  std::unordered_map<llvm::Type*, llvm::StructType*> heap_cells_;
+  // Layouts of recursive unions, by the struct type of their cells.
+  std::unordered_map<llvm::Type*, const LLVMDisjointLayout*> cells_;
+  // ABIs of lowered function types passing aggregates through memory.
+  std::unordered_map<llvm::FunctionType*, LLVMFunctionABI> abis_;
+  // Layouts of lowered types, computed on demand.
+  std::unordered_map<llvm::Type*, TypeLayout> layouts_;
 };
 
 // Synthesizes an LLVM type from the given darlang-internal type.
 class LLVMTypeGenerator : public typing::Type::Visitor {
  public:
   static llvm::Type* Generate(llvm::LLVMContext& context, typing::Type& type, LLVMTypeCache& cache);
-  static llvm::Type* Generate(llvm::LLVMContext& context, typing::TypeablePtr& typeable, LLVMTypeCache& cache);
 
   LLVMTypeGenerator(llvm::LLVMContext& context, LLVMTypeCache& cache);
 
@@ -0,0 +1,136 @@
+#include "catch.hpp"
+
+#include "backend/llvm_typer.h"
+
+namespace darlang {
+namespace backend {
+
+// Lowers a disjoint union of an integer and a string with the given layout.
+static llvm::StructType* LowerIntOrString(llvm::LLVMContext& context, const llvm::DataLayout& layout) {
+  std::vector<std::unique_ptr<typing::Type>> types;
+  types.push_back(std::make_unique<typing::Primitive>(typing::PrimitiveType::Int64));
+  types.push_back(std::make_unique<typing::Primitive>(typing::PrimitiveType::String));
+  typing::DisjointUnion disjoint(std::move(types));
+
+  LLVMTypeCache cache(layout);
+  return llvm::cast<llvm::StructType>(LLVMTypeGenerator::Generate(context, disjoint, cache));
+}
+
+TEST_CASE("disjoint unions are laid out for the target", "[llvmtyper]") {
+  llvm::LLVMContext context;
+
+  // The payload is stored in words of the strictest member alignment.
+  llvm::DataLayout layout64("e-p:64:64-i64:64");
+  auto data64 = llvm::cast<llvm::ArrayType>(LowerIntOrString(context, layout64)->getElementType(1));
+  REQUIRE(data64->getElementType()->isIntegerTy(64));
+  REQUIRE(data64->getNumElements() == 1);
+
+  // 32-bit targets only align 64-bit integers to 4 bytes.
+  llvm::LLVMContext context32;
+  llvm::DataLayout layout32("e-p:32:32-i64:32");
+  auto data32 = llvm::cast<llvm::ArrayType>(LowerIntOrString(context32, layout32)->getElementType(1));
+  REQUIRE(data32->getElementType()->isIntegerTy(32));
+  REQUIRE(data32->getNumElements() == 2);
+}
+
+TEST_CASE("disjoint unions use compact tags", "[llvmtyper]") {
+  llvm::LLVMContext context;
+  llvm::DataLayout layout("e-p:64:64-i64:64");
+
+  // Two members only need the narrowest tag.
+  auto tagged = LowerIntOrString(context, layout);
+  REQUIRE(tagged->getElementType(0)->isIntegerTy(8));
+
+  // A pointer is never null, which stands in for the unit member instead.
+  std::vector<std::unique_ptr<typing::Type>> types;
+  types.push_back(std::make_unique<typing::Tuple>(std::vector<typing::Tuple::TaggedType>()));
+  types.push_back(std::make_unique<typing::Primitive>(typing::PrimitiveType::String));
+  typing::DisjointUnion optional(std::move(types));
+  LLVMTypeCache cache(layout);
+  REQUIRE(LLVMTypeGenerator::Generate(context, optional, cache)->isPointerTy());
+  auto optional_layout = cache.LookupDisjoint(optional);
+  REQUIRE(optional_layout);
+  REQUIRE(optional_layout->kind == LLVMDisjointLayout::NULLABLE);
+}
+
+// Returns a cons cell `(item, self)` of a recursive union, whose recurrence
+// is pointed at the union once built.
+static std::unique_ptr<typing::Type> Cons(typing::PrimitiveType item,
+                                          std::vector<typing::Recurrence*>& recurrences) {
+  std::vector<typing::Tuple::TaggedType> items;
+  items.emplace_back("", std::make_unique<typing::Primitive>(item));
+  auto self = std::make_unique<typing::Recurrence>();
+  recurrences.push_back(self.get());
+  items.emplace_back("", std::move(self));
+  return std::make_unique<typing::Tuple>(std::move(items));
+}
+
+// Lowers a recursive union of two members, returning its layout.
+static const LLVMDisjointLayout& LowerRecursive(llvm::LLVMContext& context, LLVMTypeCache& cache,
+                                                std::unique_ptr<typing::Type> a, std::unique_ptr<typing::Type> b,
+                                                std::vector<typing::Recurrence*>& recurrences) {
+  std::vector<std::unique_ptr<typing::Type>> types;
+  types.push_back(std::move(a));
+  types.push_back(std::move(b));
+  typing::DisjointUnion disjoint(std::move(types));
+  disjoint.set_recursive(true);
+  for (auto recurrence : recurrences) {
+    recurrence->set_parent_type(&disjoint);
+  }
+  REQUIRE(LLVMTypeGenerator::Generate(context, disjoint, cache)->isPointerTy());
+  return *cache.LookupDisjoint(disjoint);
+}
+
+TEST_CASE("recursive unions of heap cells have no cells of their own", "[llvmtyper]") {
+  llvm::LLVMContext context;
+  llvm::DataLayout layout("e-p:64:64-i64:64");
+
+  // A list is a pointer to its first cons cell, or null when empty. The cell
+  // references the rest of the list in turn.
+  LLVMTypeCache list_cache(layout);
+  std::vector<typing::Recurrence*> list_self;
+  auto unit = std::make_unique<typing::Tuple>(std::vector<typing::Tuple::TaggedType>());
+  auto& list = LowerRecursive(context, list_cache, std::move(unit), Cons(typing::PrimitiveType::Int64, list_self),
+                              list_self);
+  REQUIRE(list.kind == LLVMDisjointLayout::NULLABLE);
+  auto cons_type = list_cache.HeapCell(list.members[1]);
+  REQUIRE(cons_type);
+  REQUIRE(list_cache.LookupTaggedRef(cons_type->getElementType(1)) == &list);
+
+  // Unions of several cells tag the low bits of the pointer instead.
+  LLVMTypeCache pair_cache(layout);
+  std::vector<typing::Recurrence*> pair_self;
+  auto int_cons = Cons(typing::PrimitiveType::Int64, pair_self);
+  auto& pair = LowerRecursive(context, pair_cache, std::move(int_cons), Cons(typing::PrimitiveType::String, pair_self),
+                              pair_self);
+  REQUIRE(pair.kind == LLVMDisjointLayout::POINTER_TAGGED);
+
+  // Members held by value still need a tagged cell.
+  LLVMTypeCache tally_cache(layout);
+  std::vector<typing::Recurrence*> tally_self;
+  auto& tally = LowerRecursive(context, tally_cache, std::make_unique<typing::Primitive>(typing::PrimitiveType::Int64),
+                               Cons(typing::PrimitiveType::String, tally_self), tally_self);
+  REQUIRE(tally.kind == LLVMDisjointLayout::TAGGED);
+}
+
+TEST_CASE("tuple fields are ordered by alignment", "[llvmtyper]") {
+  llvm::LLVMContext context;
+  llvm::DataLayout layout("e-p:64:64-i64:64");
+  LLVMTypeCache cache(layout);
+
+  std::vector<typing::Tuple::TaggedType> items;
+  items.emplace_back("", std::make_unique<typing::Primitive>(typing::PrimitiveType::Boolean));
+  items.emplace_back("", std::make_unique<typing::Primitive>(typing::PrimitiveType::Int64));
+  items.emplace_back("", std::make_unique<typing::Primitive>(typing::PrimitiveType::Boolean));
+  typing::Tuple tuple(std::move(items));
+
+  // Both booleans pack into the tail of a single word.
+  auto struct_type = LLVMTypeGenerator::Generate(context, tuple, cache);
+  REQUIRE(cache.AllocSize(struct_type) == 16);
+  REQUIRE(cache.FieldIndex(struct_type, 0) == 1);
+  REQUIRE(cache.FieldIndex(struct_type, 1) == 0);
+  REQUIRE(cache.FieldIndex(struct_type, 2) == 2);
+}
+
+}  // namespace backend
+}  // namespace darlang
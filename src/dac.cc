@@ -4,18 +4,68 @@
 #include "logger.h"
 #include "parsing/lexer.h"
 #include "parsing/parser.h"
+#include "scoping/scope_transform.h"
 #include "backend/llvm_backend.h"
+#include "backend/llvm_jit.h"
+#include "backend/llvm_optimizer.h"
+#include "backend/llvm_target.h"
 #include "typing/type_transform.h"
 #include "typing/module_specializer.h"
 #include "ast/prettyprinter.h"
 
 // XXX(acomminos): just for printing IR
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/SystemUtils.h"
+#include "llvm/Support/Timer.h"
+
+enum class EmitKind {
+  BITCODE,
+  LLVM_IR,
+  OBJECT,
+  EXECUTABLE,
+};
+
+static const char* kPhaseGroup = "dac";
+static const char* kPhaseGroupDescription = "Compilation phase timing report";
 
 int main(int argc, char* argv[]) {
   llvm::cl::opt<std::string> input_file(llvm::cl::Positional, llvm::cl::desc("<input file>"), llvm::cl::init("-"));
   llvm::cl::opt<bool> print_ast("print-ast", llvm::cl::desc("pretty prints the AST instead of doing anything useful"), llvm::cl::init(false));
+  llvm::cl::opt<darlang::backend::OptLevel> opt_level(
+      llvm::cl::desc("optimization level:"),
+      llvm::cl::values(
+        clEnumValN(darlang::backend::OptLevel::O0, "O0", "no optimization (default)"),
+        clEnumValN(darlang::backend::OptLevel::O1, "O1", "optimize quickly, without hindering debuggability"),
+        clEnumValN(darlang::backend::OptLevel::O2, "O2", "optimize for speed"),
+        clEnumValN(darlang::backend::OptLevel::O3, "O3", "optimize aggressively for speed")),
+      llvm::cl::init(darlang::backend::OptLevel::O0));
+  llvm::cl::opt<bool> time_opt("time-opt", llvm::cl::desc("reports the time spent in each optimization pass"), llvm::cl::init(false));
+  llvm::cl::opt<EmitKind> emit("emit", llvm::cl::desc("output kind:"),
+      llvm::cl::values(
+        clEnumValN(EmitKind::BITCODE, "bc", "LLVM bitcode (default)"),
+        clEnumValN(EmitKind::LLVM_IR, "llvm", "textual LLVM IR, for debugging"),
+        clEnumValN(EmitKind::OBJECT, "obj", "native object file"),
+        clEnumValN(EmitKind::EXECUTABLE, "exe", "native executable, linked against the darlang runtime")),
+      llvm::cl::init(EmitKind::BITCODE));
+  llvm::cl::opt<std::string> output_file("o", llvm::cl::desc("output file (defaults to stdout, or a.out for executables)"), llvm::cl::value_desc("filename"), llvm::cl::init("-"));
+  llvm::cl::opt<std::string> mcpu("mcpu", llvm::cl::desc("target CPU for native code, or 'native' for the host CPU"), llvm::cl::init("generic"));
+  llvm::cl::opt<std::string> mattr("mattr", llvm::cl::desc("target features for native code (e.g. +avx2,-sse4.1)"), llvm::cl::init(""));
+  llvm::cl::opt<bool> run("run", llvm::cl::desc("compiles and runs the program in-process, exiting with the result of main"), llvm::cl::init(false));
+  llvm::cl::opt<darlang::backend::GuardSelect> guard_select("guard-select", llvm::cl::desc("lowering of guards to selects:"),
+      llvm::cl::values(
+        clEnumValN(darlang::backend::GuardSelect::AUTO, "auto", "for cheap, side-effect free guards (default)"),
+        clEnumValN(darlang::backend::GuardSelect::ALWAYS, "always", "for all side-effect free guards"),
+        clEnumValN(darlang::backend::GuardSelect::NEVER, "never", "branch on every guard")),
+      llvm::cl::init(darlang::backend::GuardSelect::AUTO));
+  llvm::cl::opt<bool> refcount("refcount", llvm::cl::desc("reference counts heap values, freeing or reusing them once dead"), llvm::cl::init(true));
+  llvm::cl::opt<bool> stack_alloc("stack-alloc", llvm::cl::desc("allocates tuples that do not escape on the stack"), llvm::cl::init(true));
+  llvm::cl::opt<bool> internalize("internalize", llvm::cl::desc("gives specializations internal linkage, exposing only main"), llvm::cl::init(true));
+  llvm::cl::opt<unsigned> max_direct_aggregate("max-direct-aggregate", llvm::cl::desc("passes tuples larger than this many bytes through memory (defaults to the target's limit)"), llvm::cl::init(0));
+  llvm::cl::opt<bool> time_phases("time-phases", llvm::cl::desc("reports the time spent in each compilation phase"), llvm::cl::init(false));
 
   llvm::cl::ParseCommandLineOptions(argc, argv, "a darlang to LLVM IR compiler");
 
@@ -38,7 +88,11 @@ int main(int argc, char* argv[]) {
   darlang::parsing::TokenStream ts(l);
 
   darlang::parsing::Parser p(logger, ts);
-  auto module = p.ParseModule();
+  darlang::ast::NodePtr module;
+  {
+    llvm::NamedRegionTimer timer("parse", "Parsing", kPhaseGroup, kPhaseGroupDescription, time_phases);
+    module = p.ParseModule();
+  }
 
   if (print_ast) {
     darlang::ast::PrettyPrinter pp;
@@ -46,10 +100,163 @@ int main(int argc, char* argv[]) {
     return 0;
   }
 
+  {
+    llvm::NamedRegionTimer timer("scope", "Scoping", kPhaseGroup, kPhaseGroupDescription, time_phases);
+    darlang::scoping::ScopeTransform::Resolve(logger, *module);
+  }
+
   darlang::typing::ModuleSpecializer specializer(logger, true);
-  auto types = specializer.Specialize(*module);
+  darlang::typing::SpecializationMap* types;
+  {
+    llvm::NamedRegionTimer timer("typing", "Type inference", kPhaseGroup, kPhaseGroupDescription, time_phases);
+    types = &specializer.Specialize(*module);
+  }
+
+  // Native code requires a target machine, which determines the module's data
+  // layout prior to code generation. Bitcode and textual IR are also targeted
+  // to the host, so that they can be consumed by LTO alongside native objects,
+  // and so that the IR emitted for debugging matches the code that is run.
+  std::unique_ptr<darlang::backend::LLVMJit> jit;
+  std::unique_ptr<llvm::TargetMachine> machine;
+  llvm::DataLayout layout("");
+  if (run) {
+    auto created = darlang::backend::LLVMJit::Create(opt_level);
+    if (!created) {
+      std::cerr << std::string(created.result) << std::endl;
+      return 1;
+    }
+    jit = std::move(created.value);
+    layout = jit->layout();
+  } else {
+    auto created = darlang::backend::LLVMTarget::CreateHostMachine(mcpu, mattr, opt_level);
+    if (!created) {
+      std::cerr << std::string(created.result) << std::endl;
+      return 1;
+    }
+    machine = std::move(created.value);
+    layout = machine->createDataLayout();
+  }
+
+  darlang::backend::LLVMBackendOptions backend_options;
+  backend_options.guard_select = guard_select;
+  backend_options.reference_counting = refcount;
+  backend_options.stack_allocation = stack_alloc;
+  backend_options.internalize = internalize;
+  backend_options.max_direct_aggregate_size = max_direct_aggregate
+      ? max_direct_aggregate
+      : darlang::backend::LLVMTarget::MaxDirectAggregateSize(llvm::Triple(llvm::sys::getDefaultTargetTriple()));
 
-  llvm::LLVMContext llvm_context;
-  auto llvm_module = darlang::backend::LLVMModuleTransformer::Transform(llvm_context, types, *module);
-  llvm_module->print(llvm::outs(), nullptr);
+  auto llvm_context = std::make_unique<llvm::LLVMContext>();
+  std::unique_ptr<llvm::Module> llvm_module;
+  {
+    llvm::NamedRegionTimer timer("codegen", "IR generation", kPhaseGroup, kPhaseGroupDescription, time_phases);
+    llvm_module = darlang::backend::LLVMModuleTransformer::Transform(*llvm_context, *types, *module, layout, backend_options);
+  }
+  if (machine) {
+    llvm_module->setTargetTriple(machine->getTargetTriple().str());
+  }
+  {
+    llvm::NamedRegionTimer timer("opt", "Optimization", kPhaseGroup, kPhaseGroupDescription, time_phases);
+    darlang::backend::LLVMOptimizer::Optimize(*llvm_module, opt_level, time_opt, machine.get());
+  }
+
+  if (run) {
+    auto result = jit->AddModule(std::move(llvm_module), std::move(llvm_context));
+    if (!result) {
+      std::cerr << std::string(result) << std::endl;
+      return 1;
+    }
+
+    int64_t (*main_func)();
+    {
+      llvm::NamedRegionTimer timer("jit", "JIT compilation", kPhaseGroup, kPhaseGroupDescription, time_phases);
+      auto lookup = jit->LookupMain();
+      if (!lookup) {
+        std::cerr << std::string(lookup.result) << std::endl;
+        return 1;
+      }
+      main_func = lookup.value;
+    }
+
+    int64_t status;
+    {
+      llvm::NamedRegionTimer timer("execute", "Execution", kPhaseGroup, kPhaseGroupDescription, time_phases);
+      status = main_func();
+    }
+    if (time_phases) {
+      llvm::TimerGroup::printAll(llvm::errs());
+    }
+    return status;
+  }
+
+  {
+    llvm::NamedRegionTimer timer("emit", "Output", kPhaseGroup, kPhaseGroupDescription, time_phases);
+    std::error_code ec;
+    switch (emit) {
+      case EmitKind::BITCODE: {
+        llvm::raw_fd_ostream os(output_file, ec);
+        if (ec) {
+          std::cerr << "failed to open " << output_file << ": " << ec.message() << std::endl;
+          return 1;
+        }
+        // Refuse to write binary data to a terminal.
+        if (llvm::CheckBitcodeOutputToConsole(os)) {
+          return 1;
+        }
+        llvm::WriteBitcodeToFile(*llvm_module, os);
+        break;
+      }
+      case EmitKind::LLVM_IR: {
+        llvm::raw_fd_ostream os(output_file, ec);
+        if (ec) {
+          std::cerr << "failed to open " << output_file << ": " << ec.message() << std::endl;
+          return 1;
+        }
+        llvm_module->print(os, nullptr);
+        break;
+      }
+      case EmitKind::OBJECT: {
+        llvm::raw_fd_ostream os(output_file, ec);
+        if (ec) {
+          std::cerr << "failed to open " << output_file << ": " << ec.message() << std::endl;
+          return 1;
+        }
+        auto result = darlang::backend::LLVMTarget::EmitObject(*llvm_module, *machine, os);
+        if (!result) {
+          std::cerr << std::string(result) << std::endl;
+          return 1;
+        }
+        break;
+      }
+      case EmitKind::EXECUTABLE: {
+        // Write the object to a temporary file for the linker to consume.
+        int fd;
+        llvm::SmallString<128> object_path;
+        ec = llvm::sys::fs::createTemporaryFile("dac", "o", fd, object_path);
+        if (ec) {
+          std::cerr << "failed to create temporary object file: " << ec.message() << std::endl;
+          return 1;
+        }
+        darlang::Result result = darlang::Result::Ok();
+        {
+          llvm::raw_fd_ostream os(fd, true);
+          result = darlang::backend::LLVMTarget::EmitObject(*llvm_module, *machine, os);
+        }
+        if (result) {
+          std::string exe_file = output_file == "-" ? "a.out" : output_file.getValue();
+          result = darlang::backend::LLVMTarget::LinkExecutable(
+              object_path.str().str(), DARLANG_RUNTIME_PATH, exe_file);
+        }
+        llvm::sys::fs::remove(object_path);
+        if (!result) {
+          std::cerr << std::string(result) << std::endl;
+          return 1;
+        }
+        break;
+      }
+    }
+  }
+  if (time_phases) {
+    llvm::TimerGroup::printAll(llvm::errs());
+  }
 }
@@ -17,6 +17,11 @@ enum class ErrorCode {
 
   TYPE_INCOMPATIBLE,  // conflicting typeable constraints set
   TYPE_INDETERMINATE, // insufficient evidence to infer a typeable's class
+
+  TARGET_UNSUPPORTED, // no code generator available for the target machine
+  CODEGEN_FAILED,     // failed to emit machine code for a module
+  LINK_FAILED,        // failed to link an executable
+  EVAL_FAILED,        // failed to evaluate a constant at compile time
 };
 
 struct Result {
@@ -105,9 +105,8 @@ ast::NodePtr Parser::ParseExpr() {
   switch (ts_.PeekType()) {
     case Token::ID:
       return ParseIdent();
-// TODO(acomminos)
-//    case Token::ID_CONSTANT:
-//      return ParseConstantExpr();
+    case Token::ID_CONSTANT:
+      return ParseConstantExpr();
     case Token::BLOCK_START:
       return ParseGuard();
     case Token::BRACE_START:
@@ -153,6 +152,15 @@ ast::NodePtr Parser::ParseIdentExpr() {
   return std::move(node);
 }
 
+ast::NodePtr Parser::ParseConstantExpr() {
+  ScopedLocationAnnotator sla(*this);
+
+  auto ident = expect_next(Token::ID_CONSTANT);
+  auto node = std::make_unique<ast::ConstantExpressionNode>(ident.value);
+  sla.Set(node.get());
+  return std::move(node);
+}
+
 ast::NodePtr Parser::ParseGuard() {
   ScopedLocationAnnotator sla(*this);
 
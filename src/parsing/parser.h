@@ -26,6 +26,7 @@ class Parser {
    ast::NodePtr ParseExpr();
    ast::NodePtr ParseIdent(); // parses an expression prefixed by an id
    ast::NodePtr ParseIdentExpr();
+   ast::NodePtr ParseConstantExpr();
    ast::NodePtr ParseGuard();
    ast::NodePtr ParseInvoke();
    ast::NodePtr ParseBind();
@@ -0,0 +1,81 @@
+#include "runtime/runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct darlang_chunk {
+  struct darlang_chunk* next;
+  // Pads the header, so that the data that follows it is aligned.
+  char padding[DARLANG_ALLOC_ALIGN - sizeof(struct darlang_chunk*)];
+} darlang_chunk_t;
+
+typedef struct darlang_free_slot {
+  struct darlang_free_slot* next;
+} darlang_free_slot_t;
+
+DARLANG_THREAD_LOCAL darlang_heap_t darlang_heap = {NULL, NULL, NULL, {NULL}};
+
+static darlang_chunk_t* darlang_new_chunk(int64_t size) {
+  darlang_chunk_t* chunk = malloc(sizeof(darlang_chunk_t) + size);
+  if (!chunk) {
+    fprintf(stderr, "darlang: out of memory allocating %lld bytes\n", (long long) size);
+    abort();
+  }
+  return chunk;
+}
+
+void* darlang_alloc(int64_t size) {
+  size = (size + DARLANG_ALLOC_ALIGN - 1) / DARLANG_ALLOC_ALIGN * DARLANG_ALLOC_ALIGN;
+
+  if (size > DARLANG_LARGE_ALLOC) {
+    // Keep bump allocating from the current chunk, by placing this one behind
+    // it in the list.
+    darlang_chunk_t* chunk = darlang_new_chunk(size);
+    darlang_chunk_t** link = darlang_heap.chunks ? &darlang_heap.chunks->next : &darlang_heap.chunks;
+    chunk->next = *link;
+    *link = chunk;
+    return chunk + 1;
+  }
+
+  darlang_free_slot_t** free_list = &darlang_heap.free_lists[size / DARLANG_ALLOC_ALIGN];
+  if (*free_list) {
+    darlang_free_slot_t* slot = *free_list;
+    *free_list = slot->next;
+    return slot;
+  }
+
+  if (darlang_heap.end - darlang_heap.next < size) {
+    darlang_chunk_t* chunk = darlang_new_chunk(DARLANG_CHUNK_SIZE);
+    chunk->next = darlang_heap.chunks;
+    darlang_heap.chunks = chunk;
+    darlang_heap.next = (char*) (chunk + 1);
+    darlang_heap.end = darlang_heap.next + DARLANG_CHUNK_SIZE;
+  }
+
+  void* ptr = darlang_heap.next;
+  darlang_heap.next += size;
+  return ptr;
+}
+
+void darlang_free(void* ptr, int64_t size) {
+  // Large allocations are only reclaimed when the heap is reset.
+  size = (size + DARLANG_ALLOC_ALIGN - 1) / DARLANG_ALLOC_ALIGN * DARLANG_ALLOC_ALIGN;
+  if (!ptr || size > DARLANG_LARGE_ALLOC) {
+    return;
+  }
+  darlang_free_slot_t* slot = ptr;
+  darlang_free_slot_t** free_list = &darlang_heap.free_lists[size / DARLANG_ALLOC_ALIGN];
+  slot->next = *free_list;
+  *free_list = slot;
+}
+
+void darlang_heap_reset(void) {
+  darlang_chunk_t* chunk = darlang_heap.chunks;
+  while (chunk) {
+    darlang_chunk_t* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  memset(&darlang_heap, 0, sizeof(darlang_heap));
+}
@@ -0,0 +1,70 @@
+#ifndef DARLANG_SRC_RUNTIME_RUNTIME_H_
+#define DARLANG_SRC_RUNTIME_RUNTIME_H_
+
+#include <stdint.h>
+
+// The darlang runtime, linked into executables produced by dac. Symbols
+// declared here are referenced directly by generated code, and must retain C
+// linkage.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Each thread running darlang code allocates from a heap of its own.
+#ifdef __cplusplus
+#define DARLANG_THREAD_LOCAL thread_local
+#else
+#define DARLANG_THREAD_LOCAL _Thread_local
+#endif
+
+// Heap allocations are rounded up to a multiple of this size, keeping every
+// value suitably aligned for any of its fields.
+#define DARLANG_ALLOC_ALIGN 16
+
+// The size of the chunks that small values are bump allocated from.
+#define DARLANG_CHUNK_SIZE (64 * 1024)
+// Values larger than this receive a chunk of their own, rather than wasting
+// the remainder of the current one.
+#define DARLANG_LARGE_ALLOC (DARLANG_CHUNK_SIZE / 4)
+
+// The number of distinct sizes of freed storage to keep for reuse.
+#define DARLANG_SIZE_CLASSES (DARLANG_LARGE_ALLOC / DARLANG_ALLOC_ALIGN + 1)
+
+// The region that values are allocated from. Generated code allocates inline
+// by popping freed storage of the value's size, or else bumping `next` while
+// it stays within `end`, and otherwise calls darlang_alloc to start a new
+// chunk. Each thread has its own.
+//
+// The layout of this struct is relied upon by generated code.
+typedef struct darlang_heap {
+  char* next;
+  char* end;
+  // The chunks making up the heap, most recent first.
+  struct darlang_chunk* chunks;
+  // Freed storage, by size in units of DARLANG_ALLOC_ALIGN, each linked to
+  // the next through its first word.
+  struct darlang_free_slot* free_lists[DARLANG_SIZE_CLASSES];
+} darlang_heap_t;
+
+extern DARLANG_THREAD_LOCAL darlang_heap_t darlang_heap;
+
+// Allocates `size` bytes of heap storage for a value, where `size` is a
+// multiple of DARLANG_ALLOC_ALIGN. Aborts the program if memory is exhausted,
+// rather than returning null.
+void* darlang_alloc(int64_t size);
+
+// Returns storage allocated by darlang_alloc (or bumped inline) of the given
+// size, to be recycled by later allocations of the same size. Null pointers
+// are ignored.
+void darlang_free(void* ptr, int64_t size);
+
+// Releases every value allocated from the calling thread's heap at once.
+// Called when `main` returns.
+void darlang_heap_reset(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // DARLANG_SRC_RUNTIME_RUNTIME_H_
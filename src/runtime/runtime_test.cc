@@ -0,0 +1,92 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "runtime/runtime.h"
+
+TEST_CASE("heap allocations are aligned and distinct", "[runtime]") {
+  darlang_heap_reset();
+  auto first = static_cast<char*>(darlang_alloc(24));
+  auto second = static_cast<char*>(darlang_alloc(8));
+  REQUIRE(reinterpret_cast<uintptr_t>(first) % DARLANG_ALLOC_ALIGN == 0);
+  REQUIRE(reinterpret_cast<uintptr_t>(second) % DARLANG_ALLOC_ALIGN == 0);
+  REQUIRE(second >= first + 24);
+
+  // Small allocations continue bumping from the same chunk, even after a
+  // large allocation is given its own.
+  darlang_alloc(1 << 20);
+  auto third = static_cast<char*>(darlang_alloc(16));
+  REQUIRE(third == second + DARLANG_ALLOC_ALIGN);
+  REQUIRE(darlang_heap.next == third + 16);
+
+  darlang_heap_reset();
+  REQUIRE(darlang_heap.next == nullptr);
+  REQUIRE(darlang_heap.end == nullptr);
+  REQUIRE(darlang_heap.chunks == nullptr);
+}
+
+TEST_CASE("each thread allocates from its own heap", "[runtime]") {
+  darlang_heap_reset();
+  auto first = static_cast<char*>(darlang_alloc(16));
+  darlang_free(first, 16);
+
+  // Another thread neither sees this thread's chunk, nor recycles its freed
+  // storage.
+  void* other = nullptr;
+  std::thread thread([&] {
+    REQUIRE(darlang_heap.chunks == nullptr);
+    other = darlang_alloc(16);
+    darlang_heap_reset();
+  });
+  thread.join();
+  REQUIRE(other != first);
+  REQUIRE(darlang_heap.chunks != nullptr);
+  REQUIRE(darlang_alloc(16) == first);
+  darlang_heap_reset();
+}
+
+// Allocates storage as generated code does inline (see LLVMPrelude), or
+// returns null where it would call darlang_alloc instead.
+static void* AllocInline(int64_t size) {
+  auto& free_list = darlang_heap.free_lists[size / DARLANG_ALLOC_ALIGN];
+  if (free_list) {
+    void* slot = free_list;
+    free_list = *reinterpret_cast<darlang_free_slot**>(slot);
+    return slot;
+  }
+  if (darlang_heap.end - darlang_heap.next >= size) {
+    void* ptr = darlang_heap.next;
+    darlang_heap.next += size;
+    return ptr;
+  }
+  return nullptr;
+}
+
+TEST_CASE("freed storage is recycled without calling the runtime", "[runtime]") {
+  // Each round fills more than a chunk, then frees everything. Only the first
+  // has to call into the runtime, to start new chunks.
+  const int64_t size = 32;
+  const int num_blocks = 2 * DARLANG_CHUNK_SIZE / size;
+  darlang_heap_reset();
+  for (int round = 0; round < 4; round++) {
+    std::vector<void*> blocks;
+    int calls = 0;
+    for (int i = 0; i < num_blocks; i++) {
+      void* block = AllocInline(size);
+      if (!block) {
+        block = darlang_alloc(size);
+        calls++;
+      }
+      blocks.push_back(block);
+    }
+    REQUIRE(calls == (round == 0 ? 2 : 0));
+    for (void* block : blocks) {
+      darlang_free(block, size);
+    }
+  }
+
+  darlang_heap_reset();
+  REQUIRE(darlang_heap.free_lists[size / DARLANG_ALLOC_ALIGN] == nullptr);
+}
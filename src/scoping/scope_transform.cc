@@ -1,9 +1,105 @@
 #include "scoping/scope_transform.h"
 
+#include <cassert>
+#include "errors.h"
+
 namespace darlang {
 namespace scoping {
 
-ScopeTransform::
+/* static */
+void ScopeTransform::Resolve(Logger& log, ast::Node& module_node) {
+  ScopeTransform transform(log);
+  module_node.Visit(transform);
+}
+
+bool ScopeTransform::Module(ast::ModuleNode& node) {
+  // Constants may be referenced before their declaration.
+  for (auto& child : node.body) {
+    if (auto constant = dynamic_cast<ast::ConstantNode*>(child.get())) {
+      constants_.insert(constant->name);
+    }
+  }
+  return true;
+}
+
+bool ScopeTransform::Declaration(ast::DeclarationNode& node) {
+  LocalScope arg_scope;
+  num_locals_ = 0;
+  for (auto& arg : node.args) {
+    arg_scope.Assign(arg, num_locals_++);
+  }
+
+  scope_ = &arg_scope;
+  node.expr->Visit(*this);
+  scope_ = nullptr;
+
+  node.num_locals = num_locals_;
+  return false;
+}
+
+bool ScopeTransform::Constant(ast::ConstantNode& node) {
+  LocalScope scope;
+  num_locals_ = 0;
+
+  scope_ = &scope;
+  node.expr->Visit(*this);
+  scope_ = nullptr;
+
+  node.num_locals = num_locals_;
+  return false;
+}
+
+bool ScopeTransform::IdExpression(ast::IdExpressionNode& node) {
+  assert(scope_);
+  node.local = scope_->Lookup(node.name);
+  // No forward declarations permitted.
+  if (node.local < 0) {
+    auto result = Result::Error(ErrorCode::ID_UNDECLARED,
+                                "undeclared identifier '" + node.name + "' referenced");
+    log_.Fatal(result, node.start);
+  }
+  return false;
+}
+
+bool ScopeTransform::ConstantExpression(ast::ConstantExpressionNode& node) {
+  if (!constants_.count(node.name)) {
+    auto result = Result::Error(ErrorCode::ID_UNDECLARED,
+                                "undeclared constant '" + node.name + "' referenced");
+    log_.Fatal(result, node.start);
+  }
+  return false;
+}
+
+bool ScopeTransform::Invocation(ast::InvocationNode& node) {
+  return true;
+}
+
+bool ScopeTransform::Guard(ast::GuardNode& node) {
+  return true;
+}
+
+bool ScopeTransform::Bind(ast::BindNode& node) {
+  // The bound expression cannot refer to its own identifier.
+  node.expr->Visit(*this);
+
+  // TODO(acomminos): throw error if name is already bound?
+  LocalScope* parent_scope = scope_;
+  LocalScope bind_scope(parent_scope);
+  node.local = num_locals_++;
+  bind_scope.Assign(node.identifier, node.local);
+
+  scope_ = &bind_scope;
+  node.body->Visit(*this);
+  scope_ = parent_scope;
+  return false;
+}
+
+bool ScopeTransform::Tuple(ast::TupleNode& node) {
+  for (auto& item : node.items) {
+    std::get<ast::NodePtr>(item)->Visit(*this);
+  }
+  return false;
+}
 
 }  // namespace scoping
 }  // namespace darlang
@@ -1,10 +1,52 @@
 #ifndef DARLANG_SRC_SCOPING_SCOPE_TRANSFORM_H_
 #define DARLANG_SRC_SCOPING_SCOPE_TRANSFORM_H_
 
+#include <string>
+#include <unordered_set>
+
+#include "ast/types.h"
+#include "logger.h"
+#include "util/scoped_map.h"
+
 namespace darlang {
 namespace scoping {
 
+// Mapping of an identifier to the local slot it is bound to.
+typedef util::ScopedMap<std::string, int, -1> LocalScope;
+
+// Resolves identifiers in each declaration to function-local slots, such that
+// later passes can store per-function values in a flat vector rather than
+// performing scoped lookups by name.
+//
+// The arguments of a declaration occupy its first slots, followed by one slot
+// for each binding in traversal order. Shadowing bindings receive distinct
+// slots. Constant initializers are resolved in the same way, without
+// arguments. References to constants must name a constant in the module.
 class ScopeTransform : public ast::Visitor {
+ public:
+  // Resolves all declarations in the given module.
+  static void Resolve(Logger& log, ast::Node& module_node);
+
+  bool Module(ast::ModuleNode& node) override;
+  bool Declaration(ast::DeclarationNode& node) override;
+  bool Constant(ast::ConstantNode& node) override;
+  bool IdExpression(ast::IdExpressionNode& node) override;
+  bool ConstantExpression(ast::ConstantExpressionNode& node) override;
+  bool Invocation(ast::InvocationNode& node) override;
+  bool Guard(ast::GuardNode& node) override;
+  bool Bind(ast::BindNode& node) override;
+  bool Tuple(ast::TupleNode& node) override;
+
+ private:
+  ScopeTransform(Logger& log) : log_(log), scope_(nullptr), num_locals_(0) {}
+
+  Logger& log_;
+  // The innermost scope at the current point of traversal.
+  LocalScope* scope_;
+  // The number of slots allocated in the current declaration.
+  int num_locals_;
+  // Names of the constants declared in the module.
+  std::unordered_set<std::string> constants_;
 };
 
 }  // namespace scoping
@@ -0,0 +1,52 @@
+#include "catch.hpp"
+
+#include "scoping/scope_transform.h"
+
+namespace darlang {
+namespace scoping {
+
+TEST_CASE("arguments and bindings resolve to distinct slots", "[scopetransform]") {
+  // f(a) -> a | a; a
+  auto shadowed_ref = std::make_unique<ast::IdExpressionNode>("a");
+  auto arg_ref = std::make_unique<ast::IdExpressionNode>("a");
+  auto* shadowed_ref_ptr = shadowed_ref.get();
+  auto* arg_ref_ptr = arg_ref.get();
+
+  auto bind = std::make_unique<ast::BindNode>("a", std::move(arg_ref), std::move(shadowed_ref));
+  auto* bind_ptr = bind.get();
+
+  auto module = std::make_unique<ast::ModuleNode>();
+  auto decl = std::make_unique<ast::DeclarationNode>("f", std::vector<std::string>{"a"}, std::move(bind), true);
+  auto* decl_ptr = decl.get();
+  module->body.push_back(std::move(decl));
+
+  Logger log(std::cerr);
+  ScopeTransform::Resolve(log, *module);
+
+  REQUIRE(decl_ptr->num_locals == 2);
+  REQUIRE(arg_ref_ptr->local == 0);
+  REQUIRE(bind_ptr->local == 1);
+  REQUIRE(shadowed_ref_ptr->local == 1);
+}
+
+TEST_CASE("constant initializers resolve bindings to their own slots", "[scopetransform]") {
+  // C -> a | 1; a
+  auto literal = std::make_unique<ast::IntegralLiteralNode>();
+  auto ref = std::make_unique<ast::IdExpressionNode>("a");
+  auto* ref_ptr = ref.get();
+  auto bind = std::make_unique<ast::BindNode>("a", std::move(literal), std::move(ref));
+
+  auto module = std::make_unique<ast::ModuleNode>();
+  auto constant = std::make_unique<ast::ConstantNode>("C", std::move(bind));
+  auto* constant_ptr = constant.get();
+  module->body.push_back(std::move(constant));
+
+  Logger log(std::cerr);
+  ScopeTransform::Resolve(log, *module);
+
+  REQUIRE(constant_ptr->num_locals == 1);
+  REQUIRE(ref_ptr->local == 0);
+}
+
+}  // namespace scoping
+}  // namespace darlang
@@ -36,6 +36,12 @@ Result DisjointSolver::Solve(std::unique_ptr<Type>& out_type) {
   return Result::Ok();
 }
 
+void DisjointSolver::Release() {
+  for (auto& type : types_) {
+    type->Release();
+  }
+}
+
 Result DisjointSolver::Add(TypeablePtr typeable) {
   types_.push_back(typeable);
   return Result::Ok();
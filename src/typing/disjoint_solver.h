@@ -8,19 +8,20 @@ namespace typing {
 
 // A disjoint solver solves for a type that is of exactly one of a set of
 // disjoint typeables.
-class DisjointSolver : public Solver {
+class DisjointSolver : public Solver, public util::Pooled<DisjointSolver> {
  public:
   Result Merge(Solver& other) override { return other.MergeInto(*this); }
   Result MergeInto(DisjointSolver& other) override;
   Result Solve(std::unique_ptr<Type>& out_type) override;
+  void Release() override;
 
   // Adds the given typeable to end of the disjoint solver.
   Result Add(TypeablePtr typeable);
 
-  const std::vector<TypeablePtr>& types() const { return types_; }
+  const TypeableVector& types() const { return types_; }
 
  private:
-  std::vector<TypeablePtr> types_;
+  TypeableVector types_;
 };
 
 }  // namespace typing
@@ -53,5 +53,12 @@ Result FunctionSolver::Solve(std::unique_ptr<Type>& out_type) {
   return Result::Ok();
 }
 
+void FunctionSolver::Release() {
+  for (auto& arg : args_) {
+    arg->Release();
+  }
+  yield_->Release();
+}
+
 }  // namespace typing
 }  // namespace darlang
@@ -6,7 +6,7 @@
 namespace darlang {
 namespace typing {
 
-class FunctionSolver : public Solver {
+class FunctionSolver : public Solver, public util::Pooled<FunctionSolver> {
  public:
    // Creates a new function solver with the given number of arguments.
    // Allocates typeables for each argument, as well as the return value.
@@ -15,13 +15,14 @@ class FunctionSolver : public Solver {
    Result Merge(Solver& solver) override { return solver.MergeInto(*this); }
    Result MergeInto(FunctionSolver& other) override;
    Result Solve(std::unique_ptr<Type>& out_type) override;
+   void Release() override;
 
    int num_args() const { return args_.size(); }
-   const std::vector<TypeablePtr>& args() const { return args_; }
+   const TypeableVector& args() const { return args_; }
    const TypeablePtr yield() { return yield_; }
 
  private:
-   std::vector<TypeablePtr> args_;
+   TypeableVector args_;
    const TypeablePtr yield_;
 };
 
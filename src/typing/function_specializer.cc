@@ -5,13 +5,45 @@ namespace darlang::typing {
 
 using util::DeclarationMap;
 
+void SpecializationMap::Finalize() {
+  // Solve all specializations prior to releasing any typeables, as typeables
+  // are shared between specializations at call sites.
+  for (auto& func_specs : specs_) {
+    for (auto& spec : func_specs.second) {
+      for (auto& typeable_pair : spec.typeables) {
+        std::unique_ptr<Type> type;
+        // Omit unconstrained nodes; they cannot be referenced by codegen.
+        if (typeable_pair.second && typeable_pair.second->Solve(type)) {
+          spec.types[typeable_pair.first] = registry_.Intern(std::move(type));
+        }
+      }
+      spec.func_type = registry_.Intern(spec.func_typeable->Solve());
+    }
+  }
+
+  for (auto& func_specs : specs_) {
+    for (auto& spec : func_specs.second) {
+      for (auto& typeable_pair : spec.typeables) {
+        if (typeable_pair.second) {
+          typeable_pair.second->Release();
+        }
+      }
+      spec.func_typeable->Release();
+
+      spec.typeables.clear();
+      spec.func_typeable = nullptr;
+    }
+  }
+}
+
 Specializer::Specializer(Logger& log, const util::DeclarationMap decl_nodes)
   : log_(log), decl_nodes_(decl_nodes) {
 }
 
 Result Specializer::Specialize(std::string callee,
-                               std::vector<TypeablePtr> args,
-                               TypeablePtr& out_yield) {
+                               const TypeableVector& args,
+                               TypeablePtr& out_yield,
+                               const Specialization*& out_spec) {
   auto solver = std::make_unique<FunctionSolver>(args.size());
   TypeablePtr func_yield = solver->yield();
 
@@ -40,13 +72,14 @@ Result Specializer::Specialize(std::string callee,
   // It's not possible for us to unify against an unspecialized set of
   // arguments, since we require solvable arguments as a precondition for
   // specialization.
-  if (specs_.Unify(callee, func_typeable)) {
+  if ((out_spec = specs_.Unify(callee, func_typeable))) {
     return Result::Ok();
   }
 
   // If we failed to find an existing specialization for the given args, create
   // a new one with the arguments provided.
-  auto& spec = specs_.Add(callee, {{}, func_typeable});
+  auto& spec = specs_.Add(callee, {{}, func_typeable, {}, 0});
+  out_spec = &spec;
 
   // We can only instantiate a new specialization of a function if it was
   // defined in this module. Otherwise (e.g. for intrinsics, external
@@ -73,7 +106,7 @@ Result Specializer::AddExternal(std::string callee, TypeablePtr func_typeable) {
     return Result::Error(ErrorCode::TYPE_INDETERMINATE, "attempted to specialize with unsolvable typeable");
   }
 
-  specs_.Add(callee, {{}, func_typeable});
+  specs_.Add(callee, {{}, func_typeable, {}, 0});
 
   return Result::Ok();
 }
@@ -89,16 +122,16 @@ FunctionSpecializer::FunctionSpecializer(Logger& log,
 
 bool FunctionSpecializer::Declaration(ast::DeclarationNode& node) {
   auto solver = std::make_unique<FunctionSolver>(node.args.size());
-  std::vector<TypeablePtr> args = solver->args();
+  TypeableVector args = solver->args();
   TypeablePtr yield = solver->yield();
 
   auto func_typeable = Typeable::Create(std::move(solver));
   assert(spec_.func_typeable->Unify(func_typeable));
 
-  TypeableScope arg_scope;
+  // Arguments occupy the first local slots, followed by bindings.
+  TypeableLocals locals(node.num_locals);
   for (int i = 0; i < node.args.size(); i++) {
-    std::string arg_name = node.args[i];
-    arg_scope.Assign(arg_name, args[i].get());
+    locals[i] = args[i];
   }
 
   // Function-local and specialization-local typeables.
@@ -107,9 +140,30 @@ bool FunctionSpecializer::Declaration(ast::DeclarationNode& node) {
   // entering a cycle of callee resolution. As long as we resolve any bindings
   // before calls, we can easily exit a cycle by comparing specializations.
   TypeableMap& spec_types = spec_.typeables;
-  ExpressionTypeTransform ett(log_, spec_types, arg_scope, specializer_);
+  ExpressionTypeTransform ett(log_, spec_types, locals, specializer_, spec_.callees);
+  auto expr_typeable = ett.Annotate(*node.expr);
+
+  result_ = expr_typeable->Unify(yield);
+
+  return false;
+}
+
+bool FunctionSpecializer::Constant(ast::ConstantNode& node) {
+  auto solver = std::make_unique<FunctionSolver>(0);
+  TypeablePtr yield = solver->yield();
+
+  auto func_typeable = Typeable::Create(std::move(solver));
+  assert(spec_.func_typeable->Unify(func_typeable));
+
+  TypeableLocals locals(node.num_locals);
+  ExpressionTypeTransform ett(log_, spec_.typeables, locals, specializer_, spec_.callees);
   auto expr_typeable = ett.Annotate(*node.expr);
 
+  // Initializers are evaluated at compile time, so must be fully determined.
+  if (!expr_typeable->IsSolvable()) {
+    result_ = Result::Error(ErrorCode::TYPE_INDETERMINATE, "could not determine type of constant " + node.name);
+    return false;
+  }
   result_ = expr_typeable->Unify(yield);
 
   return false;
@@ -2,6 +2,7 @@
 #define DARLANG_SRC_TYPING_FUNCTION_SPECIALIZER_H_
 
 #include "errors.h"
+#include "typing/type_registry.h"
 #include "typing/type_transform.h"
 #include "typing/typeable.h"
 #include "util/declaration_mapper.h"
@@ -14,9 +15,20 @@ namespace darlang::typing {
 // (potentially) polymorphic function. It consists of a mapping of function
 // nodes to types, as well as a typeable backed by a FunctionSolver with
 // concrete args.
+//
+// Once finalized, the typeables are released in favour of a table of interned
+// types, which is all that later passes require.
 struct Specialization {
   TypeableMap typeables;
   TypeablePtr func_typeable;
+
+  // Solved types for each node in the function. Populated by finalization.
+  TypeTable types;
+  // The solved type of the function itself. Populated by finalization.
+  TypeID func_type;
+  // The specialization invoked by each call within the function, resolved
+  // during specialization so that codegen need not re-derive them.
+  CalleeTable callees;
 };
 
 // A collection of specializations for funtions in a module, mapping each
@@ -25,7 +37,7 @@ struct Specialization {
 class SpecializationMap {
  public:
   // Returns the list of specializations for the provided function.
-  std::list<Specialization> Get(std::string function) {
+  const std::list<Specialization>& Get(std::string function) {
     return specs_[function];
   }
 
@@ -39,18 +51,29 @@ class SpecializationMap {
   }
 
   // Attempts to find a specialization compatible with the provided function
-  // typeable, and unifies against it. Returns true on success.
-  bool Unify(std::string function, TypeablePtr func_typeable) {
+  // typeable, and unifies against it. Returns the unified specialization on
+  // success, or nullptr otherwise.
+  const Specialization* Unify(std::string function, TypeablePtr func_typeable) {
     for (const auto& spec : specs_[function]) {
       // Invariant: stored specializations are always solvable.
       if (spec.func_typeable->Unify(func_typeable)) {
-        return true;
+        return &spec;
       }
     }
-    return false;
+    return nullptr;
   }
+
+  // Solves every typeable in each specialization, interning the results into
+  // the type registry. Afterwards, releases the constraint graph; no further
+  // specializations may be added or unified.
+  void Finalize();
+
+  // Registry of all types referenced by finalized specializations.
+  const TypeRegistry& registry() const { return registry_; }
+
  private:
   std::unordered_map<std::string, std::list<Specialization>> specs_;
+  TypeRegistry registry_;
 };
 
 // A polymorphic solver for functions in a module.
@@ -60,18 +83,21 @@ class Specializer {
 
   // Attempts to synthesize a specialization of a callee based on materialized
   // argument types. Unifies all parameters against the created implementation.
-  // Returns a typeable representing the type of the function's return value.
+  // Returns a typeable representing the type of the function's return value,
+  // along with the specialization that implements the call.
   Result Specialize(std::string callee,
-                    std::vector<TypeablePtr> args,
-                    TypeablePtr& out_yield);
+                    const TypeableVector& args,
+                    TypeablePtr& out_yield,
+                    const Specialization*& out_spec);
 
   // Declares the existence of an externally-implemented function that satisfies
   // the provided typeable values. Provided typeable should be backed by a
   // FunctionSolver, and fully materializable (constrained).
   Result AddExternal(std::string callee, TypeablePtr func_typeable);
 
-  SpecializationMap specs() const {
-    return specs_;
+  // Moves ownership of all known specializations to the caller.
+  SpecializationMap TakeSpecs() {
+    return std::move(specs_);
   }
 
  private:
@@ -97,6 +123,7 @@ class FunctionSpecializer : public ast::Visitor {
   Result result() { return result_; }
 
   bool Declaration(ast::DeclarationNode& node) override;
+  bool Constant(ast::ConstantNode& node) override;
 
  private:
   Logger& log_;
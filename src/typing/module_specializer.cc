@@ -8,6 +8,8 @@ ModuleSpecializer::ModuleSpecializer(Logger& log, bool is_program)
   : log_(log), is_program_(is_program) {}
 
 SpecializationMap& ModuleSpecializer::Specialize(ast::Node& node) {
+  // The constraint graph is released by finalization, before the scope ends.
+  util::PoolArena::Scope scope(arena_);
   node.Visit(*this);
   return specs_;
 }
@@ -23,11 +25,25 @@ bool ModuleSpecializer::Module(ast::ModuleNode& node) {
   LoadIntrinsic(Intrinsic::MOD, specializer);
   LoadIntrinsic(Intrinsic::ADD, specializer);
 
+  // Constants are typed even if unreferenced, as they are evaluated
+  // regardless.
+  for (auto& child : node.body) {
+    if (auto constant = dynamic_cast<ast::ConstantNode*>(child.get())) {
+      Result res;
+      TypeablePtr constant_type;
+      const Specialization* constant_spec;
+      if (!(res = specializer.Specialize(constant->name, {}, constant_type, constant_spec))) {
+        log_.Fatal(res, constant->start);
+      }
+    }
+  }
+
   if (is_program_) {
     // TODO(acomminos): have main take in command-line args
     Result res;
     TypeablePtr main_return_type;
-    if (!(res = specializer.Specialize("main", {}, main_return_type))) {
+    const Specialization* main_spec;
+    if (!(res = specializer.Specialize("main", {}, main_return_type, main_spec))) {
       log_.Fatal(res, node.start);
     }
 
@@ -39,7 +55,10 @@ bool ModuleSpecializer::Module(ast::ModuleNode& node) {
     }
   }
 
-  specs_ = specializer.specs();
+  // Materialize all types once specialization is complete, allowing the
+  // constraint graph to be freed prior to codegen.
+  specs_ = specializer.TakeSpecs();
+  specs_.Finalize();
 
   return false;
 }
@@ -3,6 +3,7 @@
 
 #include "ast/types.h"
 #include "typing/function_specializer.h"
+#include "util/pool.h"
 
 namespace darlang::typing {
 
@@ -17,7 +18,14 @@ class ModuleSpecializer : public ast::Visitor {
 
   bool Module(ast::ModuleNode& node) override;
 
+  // Pools of the solvers, typeables and types allocated during
+  // specialization.
+  const util::PoolArena& arena() const { return arena_; }
+
  private:
+  // Declared first, as it must outlive any typeables and types held by other
+  // members.
+  util::PoolArena arena_;
   SpecializationMap specs_;
   Logger& log_;
   // If true, specializes from the "main" function as well.
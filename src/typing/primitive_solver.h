@@ -7,7 +7,7 @@
 namespace darlang {
 namespace typing {
 
-class PrimitiveSolver : public Solver {
+class PrimitiveSolver : public Solver, public util::Pooled<PrimitiveSolver> {
  public:
   PrimitiveSolver(PrimitiveType primitive);
 
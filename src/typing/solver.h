@@ -7,6 +7,7 @@
 #include "errors.h"
 #include "typing/types.h"
 #include "typing/typeable.h"
+#include "util/pool.h"
 
 namespace darlang {
 namespace typing {
@@ -23,14 +24,21 @@ class TupleSolver;
 class PrimitiveSolver;
 class DisjointSolver;
 
+// Solvers are allocated in bulk during inference; implementations should
+// derive from util::Pooled to draw their storage from the specializer's pools.
 class Solver {
  public:
+  virtual ~Solver() {}
+
   // Double-dispatch mechanism to delegate constraint union to the given solver
   // implementation. Returns an error on failure.
   virtual Result Merge(Solver& solver) = 0;
   // Attempts to materialize a type based on the constraints known to the
   // implementation. Stores the synthesized type into `out_type` on success.
   virtual Result Solve(std::unique_ptr<Type>& out_type) = 0;
+  // Releases all typeables owned by the solver. Solvers referencing other
+  // typeables must override this to allow the constraint graph to be freed.
+  virtual void Release() {}
 
   // Implementation-specific unification methods to merge the callee object
   // into the provided solver. Compatible solvers should override the
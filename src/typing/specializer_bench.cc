@@ -0,0 +1,98 @@
+// Measures the heap allocations made while specializing a synthetic,
+// call-heavy module, and how many of them are served by the specializer's
+// pools rather than the global heap.
+//
+// Exits with a failure status if pooling saves less than `kMinSavings` of
+// the allocations the specializer would otherwise make.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include "logger.h"
+#include "parsing/lexer.h"
+#include "parsing/parser.h"
+#include "scoping/scope_transform.h"
+#include "typing/module_specializer.h"
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+static const int kFunctions = 200;
+static const double kMinSavings = 0.5;
+
+// Returns a module of functions each calling the next, and building tuples
+// of their arguments.
+static std::string SyntheticModule() {
+  std::stringstream source;
+  for (int i = 0; i < kFunctions; i++) {
+    source << "f" << i << "(a, b, c) -> {\n"
+           << "  is(a, 0) : t | (a, b, c); add(b, c);\n"
+           << "         * : f" << (i + 1) % kFunctions << "(mod(a, 2), add(b, " << i << "), c);\n"
+           << "}\n";
+  }
+  source << "main() -> f0(5, 0, 1)\n";
+  return source.str();
+}
+
+int main() {
+  std::stringstream source(SyntheticModule());
+  darlang::Logger log(std::cerr);
+  darlang::parsing::Lexer lexer(log, source, "bench");
+  darlang::parsing::TokenStream tokens(lexer);
+  darlang::parsing::Parser parser(log, tokens);
+  auto module = parser.ParseModule();
+  darlang::scoping::ScopeTransform::Resolve(log, *module);
+
+  darlang::typing::ModuleSpecializer specializer(log, true);
+  size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  specializer.Specialize(*module);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  size_t heap = allocations - before;
+
+  // Without pools, each pooled object would have been allocated on its own,
+  // and no chunks would have been.
+  const auto& arena = specializer.arena();
+  size_t unpooled = heap - arena.num_chunks() + arena.num_allocations();
+  double savings = 1.0 - static_cast<double>(heap) / unpooled;
+
+  std::cout << "functions:          " << kFunctions << "\n"
+            << "specialization:     "
+            << std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() << "us\n"
+            << "heap allocations:   " << heap << "\n"
+            << "pooled allocations: " << arena.num_allocations() << " (" << arena.num_chunks() << " chunks)\n"
+            << "without pools:      " << unpooled << "\n"
+            << "savings:            " << static_cast<int>(savings * 100) << "%\n";
+  return savings >= kMinSavings ? 0 : 1;
+}
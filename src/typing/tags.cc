@@ -0,0 +1,29 @@
+#include "typing/tags.h"
+
+namespace darlang {
+namespace typing {
+
+/* static */
+TagTable& TagTable::Get() {
+  static TagTable table;
+  return table;
+}
+
+TagTable::TagTable() {
+  // Reserve the first ID for the empty tag.
+  Intern("");
+}
+
+TagID TagTable::Intern(const std::string& tag) {
+  auto it = ids_.find(tag);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+  TagID id = names_.size();
+  names_.push_back(tag);
+  ids_[tag] = id;
+  return id;
+}
+
+}  // namespace typing
+}  // namespace darlang
@@ -0,0 +1,41 @@
+#ifndef DARLANG_SRC_TYPING_TAGS_H_
+#define DARLANG_SRC_TYPING_TAGS_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace darlang {
+namespace typing {
+
+// An interned tuple item tag. Two tags are equal iff their IDs are equal.
+typedef uint32_t TagID;
+
+// The ID of the empty tag, used for untagged items.
+const TagID kNoTag = 0;
+
+// A process-wide table of interned tag names, allowing solvers to compare and
+// index tags as integers.
+class TagTable {
+ public:
+  static TagTable& Get();
+
+  // Returns the ID for the given tag name, interning it if necessary.
+  TagID Intern(const std::string& tag);
+
+  // Returns the name of a previously interned tag.
+  const std::string& Name(TagID tag) const { return names_.at(tag); }
+
+ private:
+  TagTable();
+
+  // Tag names, indexed by TagID.
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, TagID> ids_;
+};
+
+}  // namespace typing
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_TYPING_TAGS_H_
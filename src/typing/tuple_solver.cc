@@ -1,13 +1,12 @@
 #include "typing/tuple_solver.h"
 #include "typing/types.h"
-#include <unordered_set>
 
 namespace darlang {
 namespace typing {
 
 TupleSolver::TupleSolver(int num_items) : items_(num_items) {
   for (auto& item : items_) {
-    item = {"", Typeable::Create()};
+    item = {kNoTag, Typeable::Create()};
   }
 }
 
@@ -16,111 +15,118 @@ Result TupleSolver::MergeInto(TupleSolver& other) {
     return Result::Error(ErrorCode::TYPE_INCOMPATIBLE, "tuple cardinality mismatch");
   }
 
-  auto self_it = items_.begin();
-  auto other_it = other.items_.begin();
-
   for (int i = 0; i < num_items(); i++) {
-    std::string self_item_tag;
-    TypeablePtr self_item_typeable;
-    std::tie(self_item_tag, self_item_typeable) = *self_it;
-
-    std::string other_item_tag;
-    TypeablePtr other_item_typeable;
-    std::tie(other_item_tag, other_item_typeable) = *other_it;
-
-    // TODO(acomminos): consider failing unifying an empty string against a
-    // non-empty string? requires addition of wildcard constant.
-    if (self_item_tag.size() != 0 &&
-        other_item_tag.size() != 0 &&
-        self_item_tag.compare(other_item_tag) != 0)
+    TagID self_item_tag = std::get<TagID>(items_[i]);
+    TagID other_item_tag = std::get<TagID>(other.items_[i]);
+
+    // TODO(acomminos): consider failing unifying an empty tag against a
+    // non-empty tag? requires addition of wildcard constant.
+    if (self_item_tag != kNoTag &&
+        other_item_tag != kNoTag &&
+        self_item_tag != other_item_tag)
     {
-      return Result::Error(ErrorCode::TYPE_INCOMPATIBLE, "tuple tags differ at index " + i);
+      return Result::Error(ErrorCode::TYPE_INCOMPATIBLE,
+                           "tuple tags differ at index " + std::to_string(i));
     }
 
+    auto& self_item_typeable = std::get<TypeablePtr>(items_[i]);
+    auto& other_item_typeable = std::get<TypeablePtr>(other.items_[i]);
     auto item_result = other_item_typeable->Unify(self_item_typeable);
     if (!item_result) {
       return item_result;
     }
 
     // If the item in the other solver's tag is unset, set it.
-    std::string unified_tag = other_item_tag;
-    if (other_item_tag.size() == 0) {
-      unified_tag = self_item_tag;
+    Result tag_result;
+    if (!(tag_result = other.TagItem(i, self_item_tag))) {
+      return tag_result;
     }
-    *other_it = {unified_tag, other_item_typeable};
+  }
 
-    self_it++;
-    other_it++;
+  // Carry over any outstanding tag accesses.
+  llvm::SmallVector<std::pair<TagID, TypeablePtr>, 4> pending(pending_tags_.begin(), pending_tags_.end());
+  for (auto& tag_pair : pending) {
+    auto tag_result = other.ItemWithTag(tag_pair.first)->Unify(tag_pair.second);
+    if (!tag_result) {
+      return tag_result;
+    }
   }
 
   return Result::Ok();
 }
 
 Result TupleSolver::Solve(std::unique_ptr<Type>& out_type) {
-  std::vector<Tuple::TaggedType> item_types;
-  std::unordered_set<std::string> used_tags; // tags assigned to an ordered item
+  // Ensure that all items referenced by tags are present in the output type.
+  if (!pending_tags_.empty()) {
+    const std::string& tag = TagTable::Get().Name(pending_tags_.begin()->first);
+    return Result::Error(ErrorCode::TYPE_INCOMPATIBLE, "tag '" + tag + "' not declared");
+  }
 
+  std::vector<Tuple::TaggedType> item_types;
   for (auto& item : items_) {
-    std::string tag;
-    TypeablePtr typeable;
-    std::tie(tag, typeable) = item;
-
-    // Throw an error for a duplicate tag.
-    if (used_tags.find(tag) != used_tags.end()) {
-      return Result::Error(ErrorCode::TYPE_INCOMPATIBLE, "duplicate tag '" + tag + "'");
-    }
-    // Allow duplicate empty tags.
-    if (tag.size() > 0) {
-      used_tags.insert(tag);
-    }
-
-    // If this item has been accessed via a tag, unify against the tag usages.
-    auto tag_it = tagged_items_.find(tag);
-    if (tag_it != tagged_items_.end()) {
-      Result tag_result = typeable->Unify(tag_it->second);
-      if (!tag_result) {
-        return tag_result;
-      }
-    }
-
     std::unique_ptr<Type> item_type;
     Result item_result;
-    if (!(item_result = typeable->Solve(item_type))) {
+    if (!(item_result = std::get<TypeablePtr>(item)->Solve(item_type))) {
       return item_result;
     }
-    item_types.push_back({tag, std::move(item_type)});
-  }
-
-  // ensure that all items referenced by tags are present in the output type
-  for (auto& tag_pair : tagged_items_) {
-    if (used_tags.find(tag_pair.first) == used_tags.end()) {
-      return Result::Error(ErrorCode::TYPE_INCOMPATIBLE,
-                           "tag '" + tag_pair.first + "' not declared");
-    }
+    item_types.push_back({TagTable::Get().Name(std::get<TagID>(item)), std::move(item_type)});
   }
 
   out_type = std::make_unique<Tuple>(std::move(item_types));
   return Result::Ok();
 }
 
-Result TupleSolver::TagItem(int index, const std::string tag) {
-  auto& item_pair = items_[index];
-  auto& existing_tag = std::get<std::string>(item_pair);
-  if (existing_tag.size() > 0 && existing_tag.compare(tag) != 0) {
-    return Result::Error(ErrorCode::TYPE_INCOMPATIBLE, "conflicting tag at " + index);
+void TupleSolver::Release() {
+  for (auto& item : items_) {
+    std::get<TypeablePtr>(item)->Release();
+  }
+  for (auto& tag_pair : pending_tags_) {
+    tag_pair.second->Release();
+  }
+}
+
+Result TupleSolver::TagItem(int index, TagID tag) {
+  if (tag == kNoTag) {
+    return Result::Ok();
+  }
+
+  auto& item = items_[index];
+  TagID existing_tag = std::get<TagID>(item);
+  if (existing_tag == tag) {
+    return Result::Ok();
+  }
+  if (existing_tag != kNoTag) {
+    return Result::Error(ErrorCode::TYPE_INCOMPATIBLE,
+                         "conflicting tag at index " + std::to_string(index));
+  }
+  if (tag_indices_.count(tag)) {
+    return Result::Error(ErrorCode::TYPE_INCOMPATIBLE,
+                         "duplicate tag '" + TagTable::Get().Name(tag) + "'");
+  }
+
+  std::get<TagID>(item) = tag;
+  tag_indices_[tag] = index;
+
+  // If this item has been accessed via the tag, unify against the tag usages.
+  auto pending_it = pending_tags_.find(tag);
+  if (pending_it != pending_tags_.end()) {
+    TypeablePtr pending = pending_it->second;
+    pending_tags_.erase(pending_it);
+    return std::get<TypeablePtr>(item)->Unify(pending);
   }
-  existing_tag = tag;
   return Result::Ok();
 }
 
-TypeablePtr TupleSolver::ItemWithTag(const std::string tag) {
-  assert(tag.size() > 0);
-  auto it = tagged_items_.find(tag);
-  if (it != tagged_items_.end()) {
-    return it->second;
+TypeablePtr TupleSolver::ItemWithTag(TagID tag) {
+  assert(tag != kNoTag);
+  auto index_it = tag_indices_.find(tag);
+  if (index_it != tag_indices_.end()) {
+    return std::get<TypeablePtr>(items_[index_it->second]);
+  }
+  auto& typeable = pending_tags_[tag];
+  if (!typeable) {
+    typeable = Typeable::Create();
   }
-  auto typeable = Typeable::Create();
-  tagged_items_[tag] = typeable;
   return typeable;
 }
 
@@ -1,41 +1,56 @@
 #ifndef DARLANG_SRC_TYPING_TUPLE_SOLVER_H_
 #define DARLANG_SRC_TYPING_TUPLE_SOLVER_H_
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "typing/solver.h"
-#include <unordered_map>
-#include <vector>
+#include "typing/tags.h"
 
 namespace darlang {
 namespace typing {
 
 // Solves for an ordered list of types.
-class TupleSolver : public Solver {
+class TupleSolver : public Solver, public util::Pooled<TupleSolver> {
  public:
+  // A tuple item, with an optional tag (kNoTag if untagged).
+  typedef std::tuple<TagID, TypeablePtr> Item;
+
   TupleSolver(int num_items);
 
   Result Merge(Solver& solver) override { return solver.MergeInto(*this); }
   Result MergeInto(TupleSolver& other) override;
   Result Solve(std::unique_ptr<Type>& out_type) override;
+  void Release() override;
 
   // Assigns a tag to the item at the provided index.
-  // Returns an error if the item has been assigned a conflicting tag.
-  Result TagItem(int index, const std::string tag);
+  // Returns an error if the item has been assigned a conflicting tag, or if
+  // another item already bears the tag. Assigning kNoTag is a no-op.
+  Result TagItem(int index, TagID tag);
+  Result TagItem(int index, const std::string& tag) {
+    return TagItem(index, TagTable::Get().Intern(tag));
+  }
 
   // Returns a typeable for the item with the given tag.
   // Implicitly declares the existence of an item with the tag.
-  TypeablePtr ItemWithTag(const std::string tag);
+  TypeablePtr ItemWithTag(TagID tag);
+  TypeablePtr ItemWithTag(const std::string& tag) {
+    return ItemWithTag(TagTable::Get().Intern(tag));
+  }
 
   int num_items() const { return items_.size(); }
-  const std::vector<std::tuple<std::string, TypeablePtr>>& items() const { return items_; }
+  const llvm::SmallVectorImpl<Item>& items() const { return items_; }
 
  private:
   // An ordered list of tuple items, with optional tags.
-  std::vector<std::tuple<std::string, TypeablePtr>> items_;
+  llvm::SmallVector<Item, 4> items_;
+
+  // A mapping from each assigned tag to the index of its item in `items_`.
+  llvm::SmallDenseMap<TagID, int, 4> tag_indices_;
 
-  // A mapping of tag names to typeables. Populated by accessing tags for
-  // fields. All tags in this map must exist in `items_` for a valid type
-  // solution to be possible.
-  std::unordered_map<std::string, TypeablePtr> tagged_items_;
+  // Typeables for tags accessed before being assigned to an item. Entries are
+  // unified against the item and removed once the tag is assigned; any left
+  // over prevent a valid type solution.
+  llvm::SmallDenseMap<TagID, TypeablePtr, 4> pending_tags_;
 };
 
 }  // namespace typing
@@ -49,5 +49,41 @@ TEST_CASE("items with different tags cannot unify", "[tuplesolver]") {
   REQUIRE_FALSE(solver_a.Merge(solver_b));
 }
 
+TEST_CASE("tag accesses resolve to the tagged item", "[tuplesolver]") {
+  TupleSolver solver(2);
+  auto early_access = solver.ItemWithTag("age");
+  REQUIRE(solver.TagItem(1, "age"));
+  auto late_access = solver.ItemWithTag("age");
+  REQUIRE(late_access == std::get<TypeablePtr>(solver.items()[1]));
+
+  auto int_typeable = Typeable::Create(std::make_unique<PrimitiveSolver>(PrimitiveType::Int64));
+  REQUIRE(early_access->Unify(int_typeable));
+  REQUIRE(std::get<TypeablePtr>(solver.items()[0])->Unify(int_typeable));
+
+  std::unique_ptr<Type> type;
+  REQUIRE(solver.Solve(type));
+}
+
+TEST_CASE("undeclared and duplicate tags do not solve", "[tuplesolver]") {
+  TupleSolver undeclared_solver(1);
+  undeclared_solver.ItemWithTag("missing");
+  std::unique_ptr<Type> type;
+  REQUIRE_FALSE(undeclared_solver.Solve(type));
+
+  TupleSolver duplicate_solver(2);
+  REQUIRE(duplicate_solver.TagItem(0, "hello"));
+  REQUIRE_FALSE(duplicate_solver.TagItem(1, "hello"));
+}
+
+TEST_CASE("small tuples store their items inline", "[tuplesolver]") {
+  auto inline_items = [](const TupleSolver& solver) {
+    auto items = reinterpret_cast<const char*>(solver.items().data());
+    auto object = reinterpret_cast<const char*>(&solver);
+    return items >= object && items < object + sizeof(solver);
+  };
+  REQUIRE(inline_items(TupleSolver(4)));
+  REQUIRE_FALSE(inline_items(TupleSolver(5)));
+}
+
 }  // namespace typing
 }  // namespace darlang
@@ -0,0 +1,21 @@
+#include "typing/type_registry.h"
+
+namespace darlang {
+namespace typing {
+
+TypeID TypeRegistry::Intern(std::unique_ptr<Type> type) {
+  assert(type);
+  std::string hash = type->Hash();
+  auto it = ids_.find(hash);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+
+  TypeID id = types_.size();
+  types_.push_back(std::move(type));
+  ids_[hash] = id;
+  return id;
+}
+
+}  // namespace typing
+}  // namespace darlang
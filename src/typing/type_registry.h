@@ -0,0 +1,49 @@
+#ifndef DARLANG_SRC_TYPING_TYPE_REGISTRY_H_
+#define DARLANG_SRC_TYPING_TYPE_REGISTRY_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast/util.h"
+#include "typing/types.h"
+
+namespace darlang {
+namespace typing {
+
+// An index identifying an interned type within a TypeRegistry.
+typedef uint32_t TypeID;
+
+// Mapping of nodes to their solved, interned types.
+typedef ast::AnnotationMap<TypeID> TypeTable;
+
+// Owns concrete types synthesized by the solver, uniquing them by hash.
+// Structurally identical types share a single TypeID (and allocation), so that
+// later passes can store and compare types as integers.
+class TypeRegistry {
+ public:
+  // Takes ownership of the given type, returning the ID of an equivalent
+  // registered type if one exists.
+  TypeID Intern(std::unique_ptr<Type> type);
+
+  // Returns the type associated with an ID produced by this registry.
+  Type& Get(TypeID id) const {
+    assert(id < types_.size());
+    return *types_[id];
+  }
+
+  size_t size() const { return types_.size(); }
+
+ private:
+  // Interned types, indexed by TypeID.
+  std::vector<std::unique_ptr<Type>> types_;
+  // A mapping from type hashes to their index in `types_`.
+  std::unordered_map<std::string, TypeID> ids_;
+};
+
+}  // namespace typing
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_TYPING_TYPE_REGISTRY_H_
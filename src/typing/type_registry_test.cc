@@ -0,0 +1,41 @@
+#include "catch.hpp"
+
+#include "typing/primitive_solver.h"
+#include "typing/tuple_solver.h"
+#include "typing/type_registry.h"
+#include "typing/types.h"
+
+namespace darlang {
+namespace typing {
+
+TEST_CASE("identical types share an interned id", "[typeregistry]") {
+  TypeRegistry registry;
+  TypeID int_id = registry.Intern(std::make_unique<Primitive>(PrimitiveType::Int64));
+  TypeID other_int_id = registry.Intern(std::make_unique<Primitive>(PrimitiveType::Int64));
+  TypeID bool_id = registry.Intern(std::make_unique<Primitive>(PrimitiveType::Boolean));
+
+  REQUIRE(int_id == other_int_id);
+  REQUIRE(int_id != bool_id);
+  REQUIRE(registry.size() == 2);
+  REQUIRE(registry.Get(bool_id).Hash() == "bool");
+}
+
+TEST_CASE("released recursive typeables are freed", "[typeregistry]") {
+  std::weak_ptr<Typeable> weak_tuple;
+  {
+    // Construct a self-referential tuple, forming a cycle between the tuple's
+    // typeable and the item typeable owned by its solver.
+    auto solver = std::make_unique<TupleSolver>(1);
+    auto item = std::get<TypeablePtr>(solver->items()[0]);
+    auto tuple = Typeable::Create(std::move(solver));
+    REQUIRE(item->Unify(tuple));
+    REQUIRE(tuple->IsSolvable());
+
+    weak_tuple = tuple;
+    tuple->Release();
+  }
+  REQUIRE(weak_tuple.expired());
+}
+
+}  // namespace typing
+}  // namespace darlang
@@ -11,23 +11,21 @@
 namespace darlang {
 namespace typing {
 
-TypeablePtr ExpressionTypeTransform::AnnotateChild(ast::Node& node, const TypeableScope& scope) {
-  return ExpressionTypeTransform(log_, annotations(), scope, specializer_).Annotate(node);
+TypeablePtr ExpressionTypeTransform::AnnotateChild(ast::Node& node) {
+  return ExpressionTypeTransform(log_, annotations(), locals_, specializer_, callees_).Annotate(node);
 }
 
 bool ExpressionTypeTransform::IdExpression(ast::IdExpressionNode& node, TypeablePtr& out_typeable) {
   auto id_typeable = Typeable::Create();
 
-  auto scope_typeable = scope_.Lookup(node.name);
-  // No forward declarations permitted.
-  if (!scope_typeable) {
-    auto result = Result::Error(ErrorCode::ID_UNDECLARED,
-                                "undeclared identifier '" + node.name + "' referenced");
-    log_.Fatal(result, node.start);
-  }
+  // Identifiers are resolved to slots by the scoping pass, and bindings are
+  // always annotated before their bodies.
+  assert(node.local >= 0 && node.local < locals_.size());
+  auto& local_typeable = locals_[node.local];
+  assert(local_typeable);
 
   Result result;
-  if (!(result = scope_typeable->Unify(id_typeable))) {
+  if (!(result = local_typeable->Unify(id_typeable))) {
     log_.Fatal(result, node.start);
   }
 
@@ -36,6 +34,21 @@ bool ExpressionTypeTransform::IdExpression(ast::IdExpressionNode& node, Typeable
   return false;
 }
 
+bool ExpressionTypeTransform::ConstantExpression(ast::ConstantExpressionNode& node, TypeablePtr& out_typeable) {
+  // Constants are typed as functions taking no arguments, so share a single
+  // specialization between all references.
+  auto yield = Typeable::Create();
+
+  Result result;
+  const Specialization* constant = nullptr;
+  if (!(result = specializer_.Specialize(node.name, {}, yield, constant))) {
+    log_.Fatal(result, node.start);
+  }
+  callees_[node.id] = constant;
+  out_typeable = yield;
+  return false;
+}
+
 bool ExpressionTypeTransform::IntegralLiteral(ast::IntegralLiteralNode& node, TypeablePtr& out_typeable) {
   auto int_solver = std::make_unique<PrimitiveSolver>(PrimitiveType::Int64);
   out_typeable = Typeable::Create(std::move(int_solver));
@@ -50,22 +63,24 @@ bool ExpressionTypeTransform::StringLiteral(ast::StringLiteralNode& node, Typeab
 
 bool ExpressionTypeTransform::Invocation(ast::InvocationNode& node, TypeablePtr& out_typeable) {
   // TODO(acomminos): don't perform polymorphic dispatch typing for lambdas
-  std::vector<TypeablePtr> args;
+  TypeableVector args;
   for (int i = 0; i < node.args.size(); i++) {
     args.push_back(AnnotateChild(*node.args[i]));
   }
   auto yield = Typeable::Create();
 
   Result result;
-  if (!(result = specializer_.Specialize(node.callee, args, yield))) {
+  const Specialization* callee = nullptr;
+  if (!(result = specializer_.Specialize(node.callee, args, yield, callee))) {
     log_.Fatal(result, node.start);
   }
+  callees_[node.id] = callee;
   out_typeable = yield;
   return false;
 }
 
 bool ExpressionTypeTransform::Guard(ast::GuardNode& node, TypeablePtr& out_typeable) {
-  std::vector<TypeablePtr> case_types;
+  TypeableVector case_types;
   for (auto& guard_case : node.cases) {
     case_types.push_back(AnnotateChild(*guard_case.second));
   }
@@ -73,7 +88,7 @@ bool ExpressionTypeTransform::Guard(ast::GuardNode& node, TypeablePtr& out_typea
 
   // Attempt to unify all branches of the guard expression. If this fails, fall
   // back to a disjoint type.
-  std::vector<TypeablePtr> reduced_case_types;
+  TypeableVector reduced_case_types;
   for (auto& type : case_types) {
     // Invariant: all elements of `reduced_case_types` are disjoint.
     bool unified = false;
@@ -102,15 +117,13 @@ bool ExpressionTypeTransform::Guard(ast::GuardNode& node, TypeablePtr& out_typea
 }
 
 bool ExpressionTypeTransform::Bind(ast::BindNode& node, TypeablePtr& out_typeable) {
-  TypeableScope bind_scope(&scope_);
-
   // Compute the type of the identifier-bound expression, and use it in the
   // scope of the following body.
   auto expr_typeable = AnnotateChild(*node.expr);
-  // TODO(acomminos): throw error if name is already bound?
-  bind_scope.Assign(node.identifier, expr_typeable.get());
+  assert(node.local >= 0 && node.local < locals_.size());
+  locals_[node.local] = expr_typeable;
 
-  auto body_typeable = AnnotateChild(*node.body, bind_scope);
+  auto body_typeable = AnnotateChild(*node.body);
 
   auto typeable = Typeable::Create();
   assert(typeable->Unify(body_typeable));
@@ -129,7 +142,7 @@ bool ExpressionTypeTransform::Tuple(ast::TupleNode& node, TypeablePtr& out_typea
 
     // Check to make sure the tag at the item's ordinal position does not
     // conflict with any other tag specifiers.
-    auto& child_tag = std::get<std::string>(node.items[i]);
+    TagID child_tag = TagTable::Get().Intern(std::get<std::string>(node.items[i]));
     if (!(result = solver->TagItem(i, child_tag))) {
       log_.Fatal(result, child_node->start);
     }
@@ -6,26 +6,32 @@
 #include "ast/types.h"
 #include "ast/util.h"
 #include "typing/solver.h"
-#include "util/scoped_map.h"
 #include "logger.h"
 
 namespace darlang {
 namespace typing {
 
-// Mapping of an identifier to a typeable owned by some AST node.
-typedef util::ScopedMap<std::string, Typeable*> TypeableScope;
+// Typeables of a function's arguments and bindings, indexed by the local slots
+// assigned by scoping::ScopeTransform.
+typedef std::vector<TypeablePtr> TypeableLocals;
 // Mapping of nodes to typeable annotations.
 // Owns the memory for all typeables.
 typedef std::unordered_map<ast::NodeID, TypeablePtr> TypeableMap;
 
 class Specializer;
+struct Specialization;
+
+// Mapping of call sites to the specialization of their callee.
+typedef ast::AnnotationMap<const Specialization*> CalleeTable;
 
 // Recursively annotates expression nodes with typeables, and returns the
 // typeable acting as the return value for the expression.
 class ExpressionTypeTransform : public ast::AnnotatedVisitor<TypeablePtr> {
  public:
-  ExpressionTypeTransform(Logger& log, TypeableMap& typeables, const TypeableScope& scope, Specializer& specializer)
-    : AnnotatedVisitor(typeables), log_(log), scope_(scope), specializer_(specializer) {}
+  ExpressionTypeTransform(Logger& log, TypeableMap& typeables, TypeableLocals& locals,
+                          Specializer& specializer, CalleeTable& callees)
+    : AnnotatedVisitor(typeables), log_(log), locals_(locals), specializer_(specializer)
+    , callees_(callees) {}
 
   // Annotates the given node using this transform, and returns the resulting
   // typeable generated.
@@ -35,14 +41,11 @@ class ExpressionTypeTransform : public ast::AnnotatedVisitor<TypeablePtr> {
   }
 
  private:
-  // Recursively annotates the given child node, optionally with a modified
-  // scope.
-  TypeablePtr AnnotateChild(ast::Node& node) {
-    return AnnotateChild(node, scope_);
-  }
-  TypeablePtr AnnotateChild(ast::Node& node, const TypeableScope& scope);
+  // Recursively annotates the given child node.
+  TypeablePtr AnnotateChild(ast::Node& node);
 
   bool IdExpression(ast::IdExpressionNode& node, TypeablePtr& out_typeable) override;
+  bool ConstantExpression(ast::ConstantExpressionNode& node, TypeablePtr& out_typeable) override;
   bool IntegralLiteral(ast::IntegralLiteralNode& node, TypeablePtr& out_typeable) override;
   bool StringLiteral(ast::StringLiteralNode& node, TypeablePtr& out_typeable) override;
   bool Invocation(ast::InvocationNode& node, TypeablePtr& out_typeable) override;
@@ -51,8 +54,10 @@ class ExpressionTypeTransform : public ast::AnnotatedVisitor<TypeablePtr> {
   bool Tuple(ast::TupleNode& node, TypeablePtr& out_typeable) override;
 
   Logger& log_;
-  const TypeableScope& scope_;
+  TypeableLocals& locals_;
   Specializer& specializer_;
+  // Records the specialization resolved for each call and constant reference.
+  CalleeTable& callees_;
 };
 
 }  // namespace typing
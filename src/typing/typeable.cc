@@ -1,13 +1,14 @@
 #include "typing/typeable.h"
 #include "typing/types.h"
 #include "typing/solver.h"
+#include "util/pool.h"
 
 namespace darlang {
 namespace typing {
 
 /* static */
 TypeablePtr Typeable::Create(std::unique_ptr<Solver> solver) {
-  return std::make_shared<Typeable>(std::move(solver));
+  return std::allocate_shared<Typeable>(util::PoolAllocator<Typeable>(), std::move(solver));
 }
 
 Typeable::Typeable(std::unique_ptr<Solver> solver)
@@ -99,5 +100,18 @@ bool Typeable::IsSolvable() {
   return Solve(stub);
 }
 
+void Typeable::Release() {
+  // Take ownership of our links prior to recursing, such that revisiting this
+  // typeable through a cycle is a no-op.
+  std::unique_ptr<Solver> solver = std::move(solver_);
+  TypeablePtr parent = std::move(parent_);
+  if (parent) {
+    parent->Release();
+  }
+  if (solver) {
+    solver->Release();
+  }
+}
+
 }  // namespace typing
 }  // namespace darlang
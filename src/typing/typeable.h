@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <vector>
+#include "llvm/ADT/SmallVector.h"
 #include "errors.h"
 
 namespace darlang {
@@ -15,6 +16,9 @@ class Solver;
 
 // A reference-counted typeable.
 typedef std::shared_ptr<Typeable> TypeablePtr;
+// A sequence of typeables, stored inline when there are only a few (e.g. the
+// arguments to a function).
+typedef llvm::SmallVector<TypeablePtr, 4> TypeableVector;
 
 // A constrainable handle expected to resolve to a type after application of
 // union-find to referencing AST nodes.
@@ -25,6 +29,7 @@ typedef std::shared_ptr<Typeable> TypeablePtr;
 // solver become invalid.
 class Typeable : public std::enable_shared_from_this<Typeable> {
  public:
+  // Allocates a new typeable from the typeable pool.
   static TypeablePtr Create(std::unique_ptr<Solver> solver = nullptr);
   // Instantiates a new typeable with the given solver.
   Typeable(std::unique_ptr<Solver> solver);
@@ -39,6 +44,11 @@ class Typeable : public std::enable_shared_from_this<Typeable> {
   std::unique_ptr<Type> Solve();
   // Asks the solver to synthesize a type, returning true on success.
   bool IsSolvable();
+  // Detaches this typeable from the union-find graph, recursively releasing
+  // its solver and parent. Breaks the reference cycles formed by solvers that
+  // own typeables unified with their parents, allowing the graph to be freed
+  // once all typeables have been solved.
+  void Release();
 
  private:
   // null if the typeable is completely unbound.
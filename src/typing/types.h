@@ -5,6 +5,8 @@
 #include <sstream>
 #include <vector>
 
+#include "util/pool.h"
+
 namespace darlang {
 namespace typing {
 
@@ -17,7 +19,9 @@ class Recurrence;
 // A concretely defined type, leveraging the visitor pattern to allow code
 // generators (such as the LLVM backend) to produce appropriate IR.
 //
-// Types should be owned by a unscoped, global type registry.
+// Types are owned by the registry of the specializer that solved them, and
+// draw their storage from its pools, as most solved types are duplicates
+// discarded on interning.
 class Type {
  public:
   struct Visitor {
@@ -29,6 +33,7 @@ class Type {
   };
 
   Type() : recursive_(false) {}
+  virtual ~Type() {}
 
   virtual void Visit(Visitor& visitor) = 0;
 
@@ -46,7 +51,7 @@ class Type {
 };
 
 // A function with zero or more arguments, returning a singular type.
-class Function : public Type {
+class Function : public Type, public util::Pooled<Function> {
  public:
   Function(std::vector<std::unique_ptr<Type>> arguments, std::unique_ptr<Type> yields)
     : arguments_(std::move(arguments)), yields_(std::move(yields)) {}
@@ -71,7 +76,7 @@ class Function : public Type {
 };
 
 // An ordered sequence of data.
-class Tuple : public Type {
+class Tuple : public Type, public util::Pooled<Tuple> {
  public:
   typedef std::tuple<std::string, std::unique_ptr<Type>> TaggedType;
 
@@ -101,7 +106,7 @@ enum class PrimitiveType {
   String,
 };
 
-class Primitive : public Type {
+class Primitive : public Type, public util::Pooled<Primitive> {
  public:
   Primitive(PrimitiveType type) : type_(type) {}
 
@@ -126,7 +131,7 @@ class Primitive : public Type {
   const PrimitiveType type_;
 };
 
-class DisjointUnion : public Type {
+class DisjointUnion : public Type, public util::Pooled<DisjointUnion> {
  public:
   DisjointUnion(std::vector<std::unique_ptr<Type>> types)
     : types_(std::move(types)) {}
@@ -153,7 +158,7 @@ class DisjointUnion : public Type {
 // A self-referential component of a type. Intended to be modeled using a
 // pointer to a parent type. Required to unify variable-length structures (e.g.
 // linked lists).
-class Recurrence : public Type {
+class Recurrence : public Type, public util::Pooled<Recurrence> {
  public:
   // A stub constructor, to be used as a placeholder before the parent type is
   // fully synthesized.
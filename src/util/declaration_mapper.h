@@ -6,10 +6,12 @@
 namespace darlang {
 namespace util {
 
-// A mapping from function names in a module to their appropriate AST node.
+// A mapping from function and constant names in a module to their
+// appropriate AST node.
 using DeclarationMap = std::unordered_map<std::string, ast::Node*>;
 
-// Converts declarations within a module to a map from function names to nodes.
+// Converts declarations within a module to a map from function and constant
+// names to nodes.
 class DeclarationMapper : public ast::Visitor {
  public:
   static DeclarationMap Map(ast::Node& module_node) {
@@ -31,6 +33,12 @@ class DeclarationMapper : public ast::Visitor {
     return false;
   }
 
+  bool Constant(ast::ConstantNode& node) {
+    assert(!map_[node.name]);
+    map_[node.name] = &node;
+    return false;
+  }
+
   DeclarationMap map() const { return map_; }
 
  private:
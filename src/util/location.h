@@ -1,6 +1,8 @@
 #ifndef DARLANG_SRC_UTIL_LOCATION_H_
 #define DARLANG_SRC_UTIL_LOCATION_H_
 
+#include <string>
+
 namespace darlang {
 namespace util {
 
@@ -0,0 +1,241 @@
+#ifndef DARLANG_SRC_UTIL_POOL_H_
+#define DARLANG_SRC_UTIL_POOL_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace darlang {
+namespace util {
+
+// A pool of fixed-size slots, carved out of large chunks and recycled through
+// an intrusive free list. Intended for the many small, short-lived objects
+// allocated during type inference. Chunks are freed along with the pool.
+//
+// Pools are not thread-safe.
+class FixedPool {
+ public:
+  static constexpr size_t kSlotsPerChunk = 64;
+
+  FixedPool(size_t size, size_t align)
+    : slot_size_(SlotSize(size, align)), free_list_(nullptr), num_allocations_(0) {
+    assert(align <= alignof(std::max_align_t));
+  }
+
+  FixedPool(const FixedPool&) = delete;
+  FixedPool& operator=(const FixedPool&) = delete;
+
+  void* Allocate() {
+    if (!free_list_) {
+      Grow();
+    }
+    FreeSlot* slot = free_list_;
+    free_list_ = slot->next;
+    num_allocations_++;
+    return slot;
+  }
+
+  void Free(void* ptr) {
+    auto slot = static_cast<FreeSlot*>(ptr);
+    slot->next = free_list_;
+    free_list_ = slot;
+  }
+
+  // Returns the number of chunks allocated from the system heap.
+  size_t num_chunks() const { return chunks_.size(); }
+  // Returns the number of slots handed out over the pool's lifetime.
+  size_t num_allocations() const { return num_allocations_; }
+  // Returns the number of bytes between consecutive slots.
+  size_t slot_size() const { return slot_size_; }
+
+ private:
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+
+  // Slots must be able to hold a free list link, and keep their successors
+  // aligned.
+  static size_t SlotSize(size_t size, size_t align) {
+    size_t min_align = align > alignof(FreeSlot) ? align : alignof(FreeSlot);
+    return ((size > sizeof(FreeSlot) ? size : sizeof(FreeSlot)) + min_align - 1) / min_align * min_align;
+  }
+
+  void Grow() {
+    auto chunk = std::make_unique<char[]>(slot_size_ * kSlotsPerChunk);
+    for (size_t i = 0; i < kSlotsPerChunk; i++) {
+      Free(chunk.get() + i * slot_size_);
+    }
+    chunks_.push_back(std::move(chunk));
+  }
+
+  const size_t slot_size_;
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  FreeSlot* free_list_;
+  size_t num_allocations_;
+};
+
+// A set of pools, one per slot size, owned by a single phase of compilation
+// (e.g. ModuleSpecializer). All pooled objects are freed along with the
+// arena, whether or not they were destroyed.
+//
+// Pooled objects draw from the arena made current on their thread by a
+// Scope, and must be destroyed before that arena is. Outside of any scope,
+// they are allocated from the global heap instead.
+class PoolArena {
+ public:
+  // Makes an arena current on this thread for the lifetime of the scope.
+  class Scope {
+   public:
+    explicit Scope(PoolArena& arena) : previous_(Current()) { Current() = &arena; }
+    ~Scope() { Current() = previous_; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    PoolArena* previous_;
+  };
+
+  PoolArena() = default;
+  PoolArena(const PoolArena&) = delete;
+  PoolArena& operator=(const PoolArena&) = delete;
+
+  // Returns the arena current on this thread, or nullptr outside of a scope.
+  static PoolArena*& Current() {
+    static thread_local PoolArena* current = nullptr;
+    return current;
+  }
+
+  // Returns the pool for objects of the given size and alignment, creating
+  // it on first use.
+  template <size_t Size, size_t Align>
+  FixedPool& Get() {
+    static const size_t id = NextId();
+    if (id >= pools_.size()) {
+      pools_.resize(id + 1);
+    }
+    if (!pools_[id]) {
+      pools_[id] = std::make_unique<FixedPool>(Size, Align);
+    }
+    return *pools_[id];
+  }
+
+  // Returns the total number of chunks and slot allocations of all pools.
+  size_t num_chunks() const;
+  size_t num_allocations() const;
+
+ private:
+  // Assigns each slot size an index into the pools of every arena.
+  static size_t NextId() {
+    static std::atomic<size_t> next_id(0);
+    return next_id++;
+  }
+
+  std::vector<std::unique_ptr<FixedPool>> pools_;
+};
+
+inline size_t PoolArena::num_chunks() const {
+  size_t chunks = 0;
+  for (auto& pool : pools_) {
+    chunks += pool ? pool->num_chunks() : 0;
+  }
+  return chunks;
+}
+
+inline size_t PoolArena::num_allocations() const {
+  size_t allocations = 0;
+  for (auto& pool : pools_) {
+    allocations += pool ? pool->num_allocations() : 0;
+  }
+  return allocations;
+}
+
+// Storage handed out by PoolAllocate is preceded by a header recording the
+// pool it was drawn from, or nullptr for the global heap, so that it is
+// returned there whichever arena is current when it is freed. The header
+// keeps the storage that follows it aligned.
+constexpr size_t PoolHeaderSize(size_t align) {
+  return align > sizeof(FixedPool*) ? align : sizeof(FixedPool*);
+}
+
+// Allocates storage for a T from the current arena, if any.
+template <typename T>
+void* PoolAllocate() {
+  constexpr size_t header = PoolHeaderSize(alignof(T));
+  FixedPool* pool = nullptr;
+  char* storage;
+  if (auto arena = PoolArena::Current()) {
+    pool = &arena->Get<header + sizeof(T), alignof(T)>();
+    storage = static_cast<char*>(pool->Allocate());
+  } else {
+    storage = static_cast<char*>(::operator new(header + sizeof(T)));
+  }
+  *reinterpret_cast<FixedPool**>(storage) = pool;
+  return storage + header;
+}
+
+// Frees storage allocated by PoolAllocate<T>() to the pool it came from.
+template <typename T>
+void PoolFree(void* ptr) {
+  char* storage = static_cast<char*>(ptr) - PoolHeaderSize(alignof(T));
+  if (FixedPool* pool = *reinterpret_cast<FixedPool**>(storage)) {
+    pool->Free(storage);
+  } else {
+    ::operator delete(storage);
+  }
+}
+
+// A mixin routing `new` and `delete` of T through the current arena.
+// Subclasses of T must provide their own allocation functions, as the pool
+// slots are sized exactly for T.
+template <typename T>
+struct Pooled {
+  static void* operator new(size_t size) {
+    assert(size == sizeof(T));
+    return PoolAllocate<T>();
+  }
+
+  static void operator delete(void* ptr) {
+    PoolFree<T>(ptr);
+  }
+};
+
+// A standard allocator drawing single-object allocations from the current
+// arena. Suitable for use with std::allocate_shared, which rebinds it to its
+// control block.
+template <typename T>
+struct PoolAllocator {
+  typedef T value_type;
+
+  PoolAllocator() = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    if (n == 1) {
+      return static_cast<T*>(PoolAllocate<T>());
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    if (n == 1) {
+      PoolFree<T>(ptr);
+    } else {
+      std::allocator<T>().deallocate(ptr, n);
+    }
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const { return true; }
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+}  // namespace util
+}  // namespace darlang
+
+#endif  // DARLANG_SRC_UTIL_POOL_H_
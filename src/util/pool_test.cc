@@ -0,0 +1,108 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <set>
+
+#include "util/pool.h"
+
+namespace darlang {
+namespace util {
+
+TEST_CASE("pool slots are aligned and recycled", "[pool]") {
+  const size_t slots_per_chunk = FixedPool::kSlotsPerChunk;
+  FixedPool pool(12, 4);
+  // Slots are large and aligned enough to hold a free list link.
+  REQUIRE(pool.slot_size() == 16);
+
+  std::set<void*> slots;
+  for (size_t i = 0; i < slots_per_chunk; i++) {
+    void* slot = pool.Allocate();
+    REQUIRE(reinterpret_cast<uintptr_t>(slot) % alignof(void*) == 0);
+    slots.insert(slot);
+  }
+  REQUIRE(slots.size() == slots_per_chunk);
+  REQUIRE(pool.num_chunks() == 1);
+
+  // Freed slots are handed out again before the pool grows.
+  void* slot = *slots.begin();
+  pool.Free(slot);
+  REQUIRE(pool.Allocate() == slot);
+  REQUIRE(pool.num_chunks() == 1);
+
+  pool.Allocate();
+  REQUIRE(pool.num_chunks() == 2);
+  REQUIRE(pool.num_allocations() == slots_per_chunk + 2);
+}
+
+struct Small : Pooled<Small> {
+  int64_t value;
+};
+
+struct Large : Pooled<Large> {
+  int64_t values[8];
+};
+
+TEST_CASE("pooled objects are drawn from the current arena", "[pool]") {
+  PoolArena arena;
+  {
+    PoolArena::Scope scope(arena);
+    REQUIRE(PoolArena::Current() == &arena);
+
+    // Each size is drawn from its own pool.
+    auto small = new Small();
+    auto large = new Large();
+    REQUIRE(arena.num_chunks() == 2);
+    REQUIRE(arena.num_allocations() == 2);
+    delete small;
+    delete large;
+
+    auto shared = std::allocate_shared<int64_t>(PoolAllocator<int64_t>(), 1);
+    REQUIRE(arena.num_allocations() == 3);
+
+    // Nested scopes restore the enclosing arena once they end.
+    PoolArena inner;
+    {
+      PoolArena::Scope inner_scope(inner);
+      delete new Small();
+      REQUIRE(inner.num_allocations() == 1);
+    }
+    REQUIRE(PoolArena::Current() == &arena);
+  }
+  REQUIRE(PoolArena::Current() == nullptr);
+
+  // Outside of any scope, objects come from the global heap.
+  delete new Small();
+  REQUIRE(arena.num_allocations() == 3);
+}
+
+TEST_CASE("pooled objects are freed to the pool they came from", "[pool]") {
+  PoolArena arena;
+  PoolArena inner;
+  auto heap = new Small();
+  {
+    PoolArena::Scope scope(arena);
+    Small* small;
+    {
+      PoolArena::Scope inner_scope(inner);
+      small = new Small();
+    }
+    // Objects of an inner arena are recycled by it, not the current one.
+    delete small;
+    auto other = new Small();
+    REQUIRE(other != small);
+    {
+      PoolArena::Scope inner_scope(inner);
+      REQUIRE(new Small() == small);
+      REQUIRE(inner.num_chunks() == 1);
+    }
+
+    // Objects from the global heap are returned to it.
+    delete heap;
+    REQUIRE(new Small() != heap);
+    REQUIRE(arena.num_chunks() == 1);
+    delete other;
+  }
+}
+
+}  // namespace util
+}  // namespace darlang
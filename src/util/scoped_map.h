@@ -1,6 +1,8 @@
 #ifndef DARLANG_SRC_UTIL_SCOPED_MAP_H_
 #define DARLANG_SRC_UTIL_SCOPED_MAP_H_
 
+#include <unordered_map>
+
 namespace darlang {
 namespace util {
 